@@ -0,0 +1,775 @@
+// Field kernel benchmark: charges evaluated per second for every kernel the CPU
+// supports, one point at a time and in packets of line heads, and each kernel's
+// deviation from the scalar reference at every packet size (the run fails if any
+// exceeds FIELD_KERNEL_TOLERANCE); then the fixed-count packet kernels against the
+// generic charge loop, the app's tracer at several tolerances and in each
+// reciprocal square root precision against the old fixed-step Euler tracer (field
+// evaluations per unit of line, and distance of the vertices from fine-step
+// Runge-Kutta lines), trace time against charge count for the direct sum and the
+// Barnes-Hut tree, and the fast multipole evaluator's accuracy and speed against
+// both for each expansion order, and the field lattice's build time, speed and
+// error for each resolution.
+// Build and run from this folder with 'make bench' (no raylib needed).
+
+#if !defined(_POSIX_C_SOURCE)
+    #define _POSIX_C_SOURCE 200809L     // clock_gettime
+#endif
+
+#include "field.h"
+#include "fieldtree.h"
+#include "fieldfmm.h"
+#include "fieldlattice.h"
+#include "fieldsinks.h"
+#include "fieldlines.h"
+#include "raymath.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_POINTS 4096
+#define BENCH_MIN_SECONDS 0.25
+#define BENCH_FIXED_REPEATS 5
+#define BENCH_LINES 64
+#define BENCH_LINE_STEPS 1000
+#define BENCH_STEP_SIZE 0.1f
+#define BENCH_LINE_LENGTH 150.0f        // the app's field line length and density
+#define BENCH_LINES_PER_CHARGE 3.2f
+#define BENCH_REFERENCE_STEP 0.005f     // fixed Runge-Kutta step of the reference lines
+#define BENCH_REFERENCE_POINTS ((int)(BENCH_LINE_LENGTH / BENCH_REFERENCE_STEP) + 2)
+#define BENCH_TREE_THETA FIELD_TREE_DEFAULT_THETA
+#define MAX_BENCH_CHARGES 262144    // the app's MAX_CHARGES
+
+static double BenchClock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static float RandomRange(float lo, float hi) {
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// Random scene matching the app's layout: charges on the ground area, sample
+// points where field lines actually travel
+static void BuildScene(Charge *charges, int count, Vector3 *points) {
+    for (int i = 0; i < count; i++) {
+        charges[i].position = (Vector3){ RandomRange(-20, 20), RandomRange(-2, 2), RandomRange(-20, 20) };
+        charges[i].value = (i % 2 ? -1.0f : 1.0f) * RandomRange(1, 10);
+    }
+    for (int i = 0; i < BENCH_POINTS; i++)
+        points[i] = (Vector3){ RandomRange(-25, 25), RandomRange(-5, 5), RandomRange(-25, 25) };
+}
+
+// Sum of the magnitudes of every charge's contribution at p, the scale that
+// reordering the sum can perturb the result by (in units of float epsilon)
+static double ContributionScale(const ChargeArrays *arrays, Vector3 p) {
+    double scale = 0.0;
+    for (int k = 0; k < arrays->count; k++) {
+        double rx = p.x - arrays->x[k], ry = p.y - arrays->y[k], rz = p.z - arrays->z[k];
+        scale += fabs(arrays->q[k]) / (rx*rx + ry*ry + rz*rz);
+    }
+    return scale;
+}
+
+// Largest deviation of the active kernel's field from the scalar one, relative
+// to ContributionScale(); nearest-source distances must match exactly
+static double MeasureDeviation(const ChargeArrays *arrays, const Vector3 *points) {
+    FieldKernelId id = GetFieldKernel();
+    double worst = 0.0;
+
+    for (int i = 0; i < BENCH_POINTS; i++) {
+        FieldSample reference, sample;
+        SetFieldKernel(FIELD_KERNEL_SCALAR);
+        EvaluateField(arrays, points[i], FIELD_PRECISION_EXACT, &reference);
+        SetFieldKernel(id);
+        EvaluateField(arrays, points[i], FIELD_PRECISION_EXACT, &sample);
+
+        double scale = ContributionScale(arrays, points[i]);
+        double diff = sqrt(pow(sample.x - reference.x, 2) + pow(sample.y - reference.y, 2) + pow(sample.z - reference.z, 2));
+        if (scale > 0.0 && diff / scale > worst) worst = diff / scale;
+        if (sample.minSourceDistSq != reference.minSourceDistSq)
+            worst = INFINITY;
+    }
+    return worst;
+}
+
+// Same check for the active packet kernel under the given fixed-count mode, at
+// every packet size from 1 to FIELD_PACKET_LANES: lanes past the count keep the
+// previous packet's heads, as after the tracer compacts out finished lines
+static double MeasurePacketDeviation(const ChargeArrays *arrays, const Vector3 *points, FieldFixedCountMode mode) {
+    FieldKernelId id = GetFieldKernel();
+    FieldFixedCountMode previousMode = GetFieldFixedCountMode();
+    FieldSample *reference = malloc(BENCH_POINTS * sizeof(FieldSample));
+    if (!reference) return INFINITY;
+
+    SetFieldKernel(FIELD_KERNEL_SCALAR);
+    for (int i = 0; i < BENCH_POINTS; i++) EvaluateField(arrays, points[i], FIELD_PRECISION_EXACT, &reference[i]);
+    SetFieldKernel(id);
+    SetFieldFixedCountMode(mode);
+
+    double worst = 0.0;
+    FieldPacket packet = { 0 };
+    for (int size = 1; size <= FIELD_PACKET_LANES; size++) {
+        for (int start = 0; start + size <= BENCH_POINTS; start += size) {
+            for (int lane = 0; lane < size; lane++) {
+                packet.x[lane] = points[start + lane].x;
+                packet.y[lane] = points[start + lane].y;
+                packet.z[lane] = points[start + lane].z;
+            }
+            packet.count = size;
+            EvaluateFieldPacket(arrays, &packet, FIELD_PRECISION_EXACT);
+
+            for (int lane = 0; lane < size; lane++) {
+                const FieldSample *r = &reference[start + lane];
+                double scale = ContributionScale(arrays, points[start + lane]);
+                double diff = sqrt(pow(packet.ex[lane] - r->x, 2) + pow(packet.ey[lane] - r->y, 2) + pow(packet.ez[lane] - r->z, 2));
+                if (scale > 0.0 && diff / scale > worst) worst = diff / scale;
+                if (packet.minSourceDistSq[lane] != r->minSourceDistSq)
+                    worst = INFINITY;
+            }
+        }
+    }
+
+    SetFieldFixedCountMode(previousMode);
+    free(reference);
+    return worst;
+}
+
+static double MeasureThroughput(const ChargeArrays *arrays, int count, const Vector3 *points, FieldPrecision precision) {
+    double start = BenchClock();
+    double elapsed = 0.0;
+    long long evaluations = 0;
+    volatile float sink = 0.0f;
+
+    do {
+        for (int i = 0; i < BENCH_POINTS; i++) {
+            FieldSample sample;
+            EvaluateField(arrays, points[i], precision, &sample);
+            sink += sample.x;
+        }
+        evaluations += BENCH_POINTS;
+        elapsed = BenchClock() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    (void)sink;
+    return evaluations * (double)count / elapsed;
+}
+
+// Same points evaluated FIELD_PACKET_LANES at a time, charges broadcast across lanes
+static double MeasurePacketThroughput(const ChargeArrays *arrays, int count, const Vector3 *points, FieldPrecision precision) {
+    double start = BenchClock();
+    double elapsed = 0.0;
+    long long evaluations = 0;
+    volatile float sink = 0.0f;
+    FieldPacket packet = { 0 };
+
+    do {
+        for (int i = 0; i < BENCH_POINTS; i += FIELD_PACKET_LANES) {
+            for (int lane = 0; lane < FIELD_PACKET_LANES; lane++) {
+                packet.x[lane] = points[i + lane].x;
+                packet.y[lane] = points[i + lane].y;
+                packet.z[lane] = points[i + lane].z;
+            }
+            packet.count = FIELD_PACKET_LANES;
+            EvaluateFieldPacket(arrays, &packet, precision);
+            sink += packet.ex[0];
+        }
+        evaluations += BENCH_POINTS;
+        elapsed = BenchClock() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    (void)sink;
+    return evaluations * (double)count / elapsed;
+}
+
+static double AngleBetween(FieldSample a, FieldSample b) {
+    double cx = (double)a.y*b.z - (double)a.z*b.y, cy = (double)a.z*b.x - (double)a.x*b.z, cz = (double)a.x*b.y - (double)a.y*b.x;
+    return atan2(sqrt(cx*cx + cy*cy + cz*cz), (double)a.x*b.x + (double)a.y*b.y + (double)a.z*b.z);
+}
+
+// Unit direction of the exact field at p, or zero where the field vanishes
+static Vector3 BenchDirection(const ChargeArrays *arrays, Vector3 p, long long *evaluations) {
+    FieldSample sample;
+    EvaluateField(arrays, p, FIELD_PRECISION_EXACT, &sample);
+    (*evaluations)++;
+    Vector3 field = { sample.x, sample.y, sample.z };
+    float length = Vector3Length(field);
+    return length > 0.0f ? Vector3Scale(field, 1.0f / length) : Vector3Zero();
+}
+
+// Follows the unit field from seed in fixed steps of h, by forward Euler (the
+// tracer's old scheme) or classical Runge-Kutta (the reference), ending like the
+// tracer does: in a sink, on a zero field, past radius 50 or after length.
+// Stores up to capacity points in path and returns how many were stored.
+static int TraceFixedStepLine(const ChargeArrays *arrays, const FieldSinkGrid *sinks, Vector3 seed, float h, float length, bool rungeKutta,
+                              Vector3 *path, int capacity, long long *evaluations) {
+    Vector3 p = seed;
+    int count = 0;
+    while (count < capacity) {
+        path[count++] = p;
+        if ((count - 1) * h >= length || IsInFieldSink(sinks, p) || Vector3DotProduct(p, p) > 2500.0f) break;
+
+        Vector3 k1 = BenchDirection(arrays, p, evaluations);
+        if (Vector3DotProduct(k1, k1) == 0.0f) break;
+        if (!rungeKutta) {
+            p = Vector3Add(p, Vector3Scale(k1, h));
+            continue;
+        }
+        Vector3 k2 = BenchDirection(arrays, Vector3Add(p, Vector3Scale(k1, 0.5f * h)), evaluations);
+        Vector3 k3 = BenchDirection(arrays, Vector3Add(p, Vector3Scale(k2, 0.5f * h)), evaluations);
+        Vector3 k4 = BenchDirection(arrays, Vector3Add(p, Vector3Scale(k3, h)), evaluations);
+        Vector3 sum = Vector3Add(Vector3Add(k1, k4), Vector3Scale(Vector3Add(k2, k3), 2.0f));
+        p = Vector3Add(p, Vector3Scale(sum, h / 6.0f));
+    }
+    return count;
+}
+
+// The app's full-quality trace settings with the direct sum
+static TraceQuality BenchQuality(float tolerance, FieldPrecision precision) {
+    return (TraceQuality){ .linesPerCharge = BENCH_LINES_PER_CHARGE, .lineBudget = FIELD_LINE_DEFAULT_BUDGET, 
+                           .minLinesPerSource = FIELD_LINE_DEFAULT_MIN_PER_SOURCE, .length = BENCH_LINE_LENGTH, .tolerance = tolerance, 
+                           .precision = precision };
+}
+
+// Traces every line of the scene with the app's tracer (BeginTrace, then
+// AdvanceTrace until it runs dry) into lines; returns the seconds taken and
+// counts the field evaluations made
+static double RunTracer(const Charge *charges, int count, TraceQuality quality, LineSet *lines, long long *evaluations) {
+    static unsigned int version = 0;
+    TraceState state = { 0 };
+    TraceJob job = { .version = ++version, .charges = malloc(count * sizeof(Charge)), .numCharges = count, .quality = quality };
+    if (!job.charges) return 0.0;
+    memcpy(job.charges, charges, count * sizeof(Charge));
+
+    double start = BenchClock();
+    BeginTrace(&state, job, lines, lines);
+    int taken;
+    *evaluations = 0;
+    do {
+        taken = AdvanceTrace(&state, TRACE_STEP_QUANTUM);
+        *evaluations += taken;
+    } while (taken >= TRACE_STEP_QUANTUM);
+    double seconds = BenchClock() - start;
+
+    UnloadTraceState(&state);
+    return seconds;
+}
+
+// Fine-step reference lines for up to BENCH_LINES of a scene's lines, spread
+// evenly over them
+typedef struct ReferenceLines {
+    int count;
+    int line[BENCH_LINES];          // index in the traced LineSet
+    int pointCount[BENCH_LINES];
+    Vector3 *points;                // BENCH_REFERENCE_POINTS per line
+} 
+ReferenceLines;
+
+typedef struct LineDeviation {
+    double mean, max;               // of vertices from the reference lines
+    long long vertices;
+} 
+LineDeviation;
+
+// Adds p's distance from the reference path to deviation. Vertices come in order
+// along the line, so the search starts at *cursor and stops once the path has
+// run further on than p could be; *cursor is left at the nearest point.
+static void AddDeviation(LineDeviation *deviation, const Vector3 *path, int count, Vector3 p, int *cursor) {
+    int nearest = *cursor;
+    double best = Vector3Distance(path[nearest], p);
+    for (int j = nearest + 1; j < count && (j - nearest) * BENCH_REFERENCE_STEP < 2.0 * best + 1.0; j++) {
+        double distance = Vector3Distance(path[j], p);
+        if (distance < best) {
+            best = distance;
+            nearest = j;
+        }
+    }
+    *cursor = nearest;
+    deviation->mean += best;
+    deviation->max = fmax(deviation->max, best);
+    deviation->vertices++;
+}
+
+static LineDeviation MeasureLineDeviation(const LineSet *lines, const ReferenceLines *references) {
+    LineDeviation deviation = { 0 };
+    for (int r = 0; r < references->count; r++) {
+        const FieldLine *line = &lines->lines[references->line[r]];
+        const Vector3 *path = references->points + (size_t)r * BENCH_REFERENCE_POINTS;
+        int cursor = 0;
+        for (int v = 0; v < line->vertexCount; v++)
+            AddDeviation(&deviation, path, references->pointCount[r], lines->vertices[line->firstVertex + v].position, &cursor);
+    }
+    if (deviation.vertices > 0) deviation.mean /= deviation.vertices;
+    return deviation;
+}
+
+static double LineSetLength(const LineSet *lines) {
+    double length = 0.0;
+    for (int v = 0; v + 1 < lines->vertexCount; v += 2)
+        length += Vector3Distance(lines->vertices[v].position, lines->vertices[v + 1].position);
+    return length;
+}
+
+// Exact evaluator the lattice samples and falls back to: the direct kernels
+static void EvaluateBenchPacket(const void *context, FieldPacket *packet) {
+    EvaluateFieldPacket(context, packet, FIELD_PRECISION_EXACT);
+}
+
+// Traces BENCH_LINES lines from seeds packet by packet like the tracer, with the
+// direct kernels or, given one, the lattice, the multipole evaluator or the tree
+// at BENCH_TREE_THETA; lines that end stay in their packet (frozen), so every path
+// does the same number of evaluations. Stores each line's end and returns the
+// seconds taken.
+static double TracePacketLines(const ChargeArrays *arrays, const FieldSinkGrid *sinks, const FieldTree *tree, const FieldFmm *fmm,
+                               const FieldLattice *lattice, const Vector3 *seeds, Vector3 *ends) {
+    double start = BenchClock();
+    FieldPacket packet = { 0 };
+
+    for (int first = 0; first < BENCH_LINES; first += FIELD_PACKET_LANES) {
+        bool done[FIELD_PACKET_LANES] = { false };
+        packet.count = FIELD_PACKET_LANES;
+        for (int lane = 0; lane < FIELD_PACKET_LANES; lane++) {
+            packet.x[lane] = seeds[first + lane].x;
+            packet.y[lane] = seeds[first + lane].y;
+            packet.z[lane] = seeds[first + lane].z;
+        }
+
+        for (int step = 0; step < BENCH_LINE_STEPS; step++) {
+            if (lattice) EvaluateFieldLatticePacket(lattice, &packet, EvaluateBenchPacket, arrays);
+            else if (fmm) EvaluateFieldFmmPacket(fmm, &packet);
+            else if (tree) EvaluateFieldTreePacket(tree, &packet, BENCH_TREE_THETA);
+            else EvaluateFieldPacket(arrays, &packet, FIELD_PRECISION_EXACT);
+
+            for (int lane = 0; lane < FIELD_PACKET_LANES; lane++) {
+                float length = sqrtf(packet.ex[lane]*packet.ex[lane] + packet.ey[lane]*packet.ey[lane] + packet.ez[lane]*packet.ez[lane]);
+                Vector3 head = { packet.x[lane], packet.y[lane], packet.z[lane] };
+                if (done[lane] || IsInFieldSink(sinks, head) || length == 0.0f) {
+                    done[lane] = true;
+                    continue;
+                }
+                packet.x[lane] += packet.ex[lane] / length * BENCH_STEP_SIZE;
+                packet.y[lane] += packet.ey[lane] / length * BENCH_STEP_SIZE;
+                packet.z[lane] += packet.ez[lane] / length * BENCH_STEP_SIZE;
+                float r2 = packet.x[lane]*packet.x[lane] + packet.y[lane]*packet.y[lane] + packet.z[lane]*packet.z[lane];
+                if (r2 > 2500.0f) done[lane] = true;
+            }
+        }
+
+        for (int lane = 0; lane < FIELD_PACKET_LANES; lane++)
+            ends[first + lane] = (Vector3){ packet.x[lane], packet.y[lane], packet.z[lane] };
+    }
+
+    return BenchClock() - start;
+}
+
+// Mean and largest angle, in degrees, between the tree's field and the direct one
+static void MeasureTreeAngle(const ChargeArrays *arrays, const FieldTree *tree, const Vector3 *points, double *mean, double *max) {
+    *mean = *max = 0.0;
+    for (int i = 0; i < BENCH_POINTS; i++) {
+        FieldSample exact;
+        EvaluateField(arrays, points[i], FIELD_PRECISION_EXACT, &exact);
+        FieldPacket packet = { .x = { points[i].x }, .y = { points[i].y }, .z = { points[i].z }, .count = 1 };
+        EvaluateFieldTreePacket(tree, &packet, BENCH_TREE_THETA);
+        FieldSample approximate = { .x = packet.ex[0], .y = packet.ey[0], .z = packet.ez[0] };
+
+        double angle = AngleBetween(exact, approximate) * 180.0 / PI;
+        *mean += angle / BENCH_POINTS;
+        if (angle > *max) *max = angle;
+    }
+}
+
+// Mean and largest angle, in degrees, between the lattice's field and the direct one
+static void MeasureLatticeAngle(const ChargeArrays *arrays, const FieldLattice *lattice, const Vector3 *points, double *mean, double *max) {
+    *mean = *max = 0.0;
+    for (int i = 0; i < BENCH_POINTS; i++) {
+        FieldSample exact;
+        EvaluateField(arrays, points[i], FIELD_PRECISION_EXACT, &exact);
+        FieldPacket packet = { .x = { points[i].x }, .y = { points[i].y }, .z = { points[i].z }, .count = 1 };
+        EvaluateFieldLatticePacket(lattice, &packet, EvaluateBenchPacket, arrays);
+        FieldSample approximate = { .x = packet.ex[0], .y = packet.ey[0], .z = packet.ez[0] };
+
+        double angle = AngleBetween(exact, approximate) * 180.0 / PI;
+        *mean += angle / BENCH_POINTS;
+        if (angle > *max) *max = angle;
+    }
+}
+
+// Mean and largest angle, in degrees, and the largest relative field error of the
+// multipole evaluator against the direct sum
+// Angles and relative error against the exact field, and the field error over
+// FieldFmmErrorBound plus float rounding (FIELD_KERNEL_TOLERANCE of the summed
+// contributions); returns the points where that ratio exceeds 1
+static int MeasureFmmError(const ChargeArrays *arrays, const FieldFmm *fmm, const Vector3 *points, double *mean, double *max, double *relative, 
+                           double *boundRatio) {
+    int failures = 0;
+    *mean = *max = *relative = *boundRatio = 0.0;
+    for (int i = 0; i < BENCH_POINTS; i++) {
+        FieldSample exact;
+        EvaluateField(arrays, points[i], FIELD_PRECISION_EXACT, &exact);
+        FieldPacket packet = { .x = { points[i].x }, .y = { points[i].y }, .z = { points[i].z }, .count = 1 };
+        EvaluateFieldFmmPacket(fmm, &packet);
+        FieldSample approximate = { .x = packet.ex[0], .y = packet.ey[0], .z = packet.ez[0] };
+
+        double angle = AngleBetween(exact, approximate) * 180.0 / PI;
+        *mean += angle / BENCH_POINTS;
+        if (angle > *max) *max = angle;
+
+        double error = sqrt(pow(approximate.x - exact.x, 2) + pow(approximate.y - exact.y, 2) + pow(approximate.z - exact.z, 2));
+        double length = sqrt(exact.x*exact.x + exact.y*exact.y + exact.z*exact.z);
+        if (length > 0.0 && error / length > *relative) *relative = error / length;
+
+        double bound = FieldFmmErrorBound(fmm, points[i]);
+        if (isinf(bound)) continue;
+        double ratio = error / (bound + FIELD_KERNEL_TOLERANCE * ContributionScale(arrays, points[i]));
+        if (ratio > *boundRatio) *boundRatio = ratio;
+        if (ratio > 1.0) failures++;
+    }
+    return failures;
+}
+
+int main(void) {
+    static const int chargeCounts[] = { 2, 4, 8, 32, 100, 1000 };
+    int numCounts = sizeof(chargeCounts) / sizeof(chargeCounts[0]);
+
+    int failures = 0, boundFailures = 0;
+
+    printf("%-8s %8s %16s %16s %12s %12s\n", "kernel", "charges", "charges/s", "packet ch/s", "max rel dev", "packet dev");
+
+    for (int c = 0; c < numCounts; c++) {
+        int count = chargeCounts[c];
+        Charge *charges = malloc(count * sizeof(Charge));
+        Vector3 *points = malloc(BENCH_POINTS * sizeof(Vector3));
+        ChargeArrays arrays = { 0 };
+        if (!charges || !points) return 1;
+
+        srand(12345 + count);
+        BuildScene(charges, count, points);
+        SyncChargeArrays(&arrays, charges, count, 0);
+
+        for (int id = 0; id < FIELD_KERNEL_COUNT; id++) {
+            if (!IsFieldKernelSupported((FieldKernelId)id)) continue;
+            SetFieldKernel((FieldKernelId)id);
+
+            double deviation = MeasureDeviation(&arrays, points);
+            double packetDeviation = MeasurePacketDeviation(&arrays, points, FIELD_FIXED_COUNT_OFF);
+            double rate = MeasureThroughput(&arrays, count, points, FIELD_PRECISION_EXACT);
+            double packetRate = MeasurePacketThroughput(&arrays, count, points, FIELD_PRECISION_EXACT);
+            bool failed = !(deviation <= FIELD_KERNEL_TOLERANCE && packetDeviation <= FIELD_KERNEL_TOLERANCE);
+            printf("%-8s %8d %16.3e %16.3e %12.2e %12.2e%s\n", GetFieldKernelName((FieldKernelId)id), count, rate, packetRate, deviation,
+                   packetDeviation, failed ? "  (above tolerance)" : "");
+            failures += failed;
+        }
+
+        UnloadChargeArrays(&arrays);
+        free(points);
+        free(charges);
+    }
+
+    printf("\n%-8s %8s %16s %16s %8s %6s %12s\n", "kernel", "charges", "generic ch/s", "fixed ch/s", "speedup", "used", "fixed dev");
+    for (int count = 1; count <= FIELD_FIXED_COUNT_MAX; count++) {
+        Charge *charges = malloc(count * sizeof(Charge));
+        Vector3 *points = malloc(BENCH_POINTS * sizeof(Vector3));
+        ChargeArrays arrays = { 0 };
+        if (!charges || !points) return 1;
+
+        srand(12345 + count);
+        BuildScene(charges, count, points);
+        SyncChargeArrays(&arrays, charges, count, 0);
+
+        for (int id = 0; id < FIELD_KERNEL_COUNT; id++) {
+            if (!IsFieldKernelSupported((FieldKernelId)id)) continue;
+            SetFieldKernel((FieldKernelId)id);
+
+            // Alternating best-of runs, so drift in clock speed hits both sides
+            double genericRate = 0.0, fixedRate = 0.0;
+            for (int repeat = 0; repeat < BENCH_FIXED_REPEATS; repeat++) {
+                SetFieldFixedCountMode(FIELD_FIXED_COUNT_OFF);
+                genericRate = fmax(genericRate, MeasurePacketThroughput(&arrays, count, points, FIELD_PRECISION_EXACT));
+                SetFieldFixedCountMode(FIELD_FIXED_COUNT_ALL);
+                fixedRate = fmax(fixedRate, MeasurePacketThroughput(&arrays, count, points, FIELD_PRECISION_EXACT));
+            }
+            double deviation = MeasurePacketDeviation(&arrays, points, FIELD_FIXED_COUNT_ALL);
+            bool failed = !(deviation <= FIELD_KERNEL_TOLERANCE);
+            printf("%-8s %8d %16.3e %16.3e %7.2fx %6s %12.2e%s\n", GetFieldKernelName((FieldKernelId)id), count, genericRate, fixedRate, 
+                   fixedRate / genericRate, IsFieldFixedCountMeasuredFaster((FieldKernelId)id, count) ? "yes" : "no", deviation,
+                   failed ? "  (above tolerance)" : "");
+            failures += failed;
+        }
+
+        UnloadChargeArrays(&arrays);
+        free(points);
+        free(charges);
+    }
+    SetFieldFixedCountMode(FIELD_FIXED_COUNT_MEASURED);
+
+    InitFieldKernels();
+    printf("\nruntime dispatch picks: %s\n", GetFieldKernelName(GetFieldKernel()));
+
+    static const int traceCounts[] = { 4, 32, 100 };
+    static const float tolerances[] = { 1e-1f, 3e-2f, 1e-2f, 3e-3f };
+    Vector3 *referencePoints = malloc((size_t)BENCH_LINES * BENCH_REFERENCE_POINTS * sizeof(Vector3));
+    Vector3 *eulerPath = malloc(BENCH_REFERENCE_POINTS * sizeof(Vector3));
+    if (!referencePoints || !eulerPath) return 1;
+
+    FieldKernelId runtimeKernel = GetFieldKernel();
+    printf("\n%-10s %-8s %-16s %9s %8s %6s %12s %10s %9s %10s %10s\n", "integrator", "kernel", "precision", "tolerance", "charges", "lines", "packet ch/s",
+           "evals/unit", "trace ms", "mean dev", "max dev");
+    for (int c = 0; c < (int)(sizeof(traceCounts) / sizeof(traceCounts[0])); c++) {
+        int count = traceCounts[c];
+        Charge *charges = malloc(count * sizeof(Charge));
+        Vector3 *points = malloc(BENCH_POINTS * sizeof(Vector3));
+        ChargeArrays arrays = { 0 };
+        FieldSinkGrid sinks = { 0 };
+        LineSet lines = { 0 };
+        if (!charges || !points) return 1;
+
+        srand(12345 + count);
+        BuildScene(charges, count, points);
+        SyncChargeArrays(&arrays, charges, count, 0);
+        SyncFieldSinkGrid(&sinks, charges, count, 0);
+
+        double exactRate = MeasurePacketThroughput(&arrays, count, points, FIELD_PRECISION_EXACT);
+
+        // The seeds don't depend on tolerance or precision, so one set of references serves every row
+        long long evaluations;
+        RunTracer(charges, count, BenchQuality(FIELD_LINE_DEFAULT_TOLERANCE, FIELD_PRECISION_EXACT), &lines, &evaluations);
+        ReferenceLines references = { .count = lines.lineCount < BENCH_LINES ? lines.lineCount : BENCH_LINES, .points = referencePoints };
+        for (int r = 0; r < references.count; r++) {
+            references.line[r] = (int)((long long)r * lines.lineCount / references.count);
+            references.pointCount[r] = TraceFixedStepLine(&arrays, &sinks, lines.lines[references.line[r]].seed, BENCH_REFERENCE_STEP, BENCH_LINE_LENGTH, 
+                                                          true, referencePoints + (size_t)r * BENCH_REFERENCE_POINTS, BENCH_REFERENCE_POINTS, &evaluations);
+        }
+
+        // The old fixed-step Euler tracer from the same seeds, one point at a time
+        double eulerLength = 0.0;
+        evaluations = 0;
+        LineDeviation eulerDeviation = { 0 };
+        for (int line = 0, r = 0; line < lines.lineCount; line++) {
+            int pointCount = TraceFixedStepLine(&arrays, &sinks, lines.lines[line].seed, FIELD_LINE_STEP_SIZE, BENCH_LINE_LENGTH, false, 
+                                                eulerPath, BENCH_REFERENCE_POINTS, &evaluations);
+            for (int i = 1; i < pointCount; i++) eulerLength += Vector3Distance(eulerPath[i - 1], eulerPath[i]);
+            if (r < references.count && references.line[r] == line) {
+                int cursor = 0;
+                for (int i = 0; i < pointCount; i++)
+                    AddDeviation(&eulerDeviation, referencePoints + (size_t)r * BENCH_REFERENCE_POINTS, references.pointCount[r], eulerPath[i], &cursor);
+                r++;
+            }
+        }
+        if (eulerDeviation.vertices > 0) eulerDeviation.mean /= eulerDeviation.vertices;
+        printf("%-10s %-8s %-16s %9.0e %8d %6d %12.3e %10.2f %9s %10.2e %10.2e\n", "Euler", GetFieldKernelName(runtimeKernel), 
+               GetFieldPrecisionName(FIELD_PRECISION_EXACT), FIELD_LINE_STEP_SIZE, count, lines.lineCount, exactRate, evaluations / eulerLength, "-", 
+               eulerDeviation.mean, eulerDeviation.max);
+
+        // The tracer at each tolerance in exact precision, then in each approximate
+        // precision at the default tolerance, with the runtime kernel's hardware
+        // estimate and the scalar kernel's bit-level one (which SIMD128 shares)
+        int rows = (int)(sizeof(tolerances) / sizeof(tolerances[0])) + 2 * (FIELD_PRECISION_COUNT - 1);
+        for (int row = 0; row < rows; row++) {
+            int rsqrtRow = row - (int)(sizeof(tolerances) / sizeof(tolerances[0]));
+            FieldKernelId kernel = rsqrtRow < FIELD_PRECISION_COUNT - 1 ? runtimeKernel : FIELD_KERNEL_SCALAR;
+            FieldPrecision precision = rsqrtRow < 0 ? FIELD_PRECISION_EXACT : (FieldPrecision)(rsqrtRow % (FIELD_PRECISION_COUNT - 1) + 1);
+            float tolerance = rsqrtRow < 0 ? tolerances[row] : FIELD_LINE_DEFAULT_TOLERANCE;
+            if (rsqrtRow >= FIELD_PRECISION_COUNT - 1 && runtimeKernel == FIELD_KERNEL_SCALAR) break;
+
+            SetFieldKernel(kernel);
+            double packetRate = precision == FIELD_PRECISION_EXACT ? exactRate : MeasurePacketThroughput(&arrays, count, points, precision);
+            double seconds = RunTracer(charges, count, BenchQuality(tolerance, precision), &lines, &evaluations);
+            LineDeviation deviation = MeasureLineDeviation(&lines, &references);
+            printf("%-10s %-8s %-16s %9.0e %8d %6d %12.3e %10.2f %9.2f %10.2e %10.2e\n", "BS3", GetFieldKernelName(kernel), GetFieldPrecisionName(precision), 
+                   tolerance, count, lines.lineCount, packetRate, evaluations / LineSetLength(&lines), seconds * 1000.0, deviation.mean, deviation.max);
+        }
+        SetFieldKernel(runtimeKernel);
+
+        UnloadLineSet(&lines);
+        UnloadFieldSinkGrid(&sinks);
+        UnloadChargeArrays(&arrays);
+        free(points);
+        free(charges);
+    }
+    free(eulerPath);
+    free(referencePoints);
+
+    printf("\n%8s %10s %12s %12s %8s %10s %10s %12s\n", "charges", "build ms", "direct s", "tree s", "speedup", "mean deg", "max deg", "mean drift");
+    static const int treeCounts[] = { 100, 1000, 2000, 5000, FIELD_TREE_MIN_CHARGES, 10000, 100000 };
+    for (int c = 0; c < (int)(sizeof(treeCounts) / sizeof(treeCounts[0])); c++) {
+        int count = treeCounts[c];
+        Charge *charges = malloc(count * sizeof(Charge));
+        Vector3 *points = malloc(BENCH_POINTS * sizeof(Vector3));
+        ChargeArrays arrays = { 0 };
+        FieldSinkGrid sinks = { 0 };
+        FieldTree tree = { 0 };
+        if (!charges || !points) return 1;
+
+        srand(12345 + count);
+        BuildScene(charges, count, points);
+        SyncChargeArrays(&arrays, charges, count, 0);
+        SyncFieldSinkGrid(&sinks, charges, count, 0);
+
+        double buildStart = BenchClock();
+        SyncFieldTree(&tree, charges, count, 0);
+        double buildTime = BenchClock() - buildStart;
+
+        Vector3 seeds[BENCH_LINES], directEnds[BENCH_LINES], treeEnds[BENCH_LINES];
+        for (int line = 0; line < BENCH_LINES; line++) {
+            int source = (2 * (line / FIELD_PACKET_LANES)) % count;
+            seeds[line] = (Vector3){ charges[source].position.x + RandomRange(-0.3f, 0.3f), charges[source].position.y + RandomRange(-0.3f, 0.3f),
+                                     charges[source].position.z + RandomRange(-0.3f, 0.3f) };
+        }
+
+        double directTime = TracePacketLines(&arrays, &sinks, NULL, NULL, NULL, seeds, directEnds);
+        double treeTime = TracePacketLines(&arrays, &sinks, &tree, NULL, NULL, seeds, treeEnds);
+        double meanAngle, maxAngle, meanDrift = 0.0;
+        MeasureTreeAngle(&arrays, &tree, points, &meanAngle, &maxAngle);
+        for (int line = 0; line < BENCH_LINES; line++) {
+            Vector3 a = directEnds[line], b = treeEnds[line];
+            meanDrift += sqrt(pow(a.x - b.x, 2) + pow(a.y - b.y, 2) + pow(a.z - b.z, 2)) / BENCH_LINES;
+        }
+
+        printf("%8d %10.2f %12.3f %12.3f %7.2fx %10.2e %10.2e %12.2e\n", count, buildTime * 1e3, directTime, treeTime, directTime / treeTime,
+               meanAngle, maxAngle, meanDrift);
+
+        UnloadFieldTree(&tree);
+        UnloadFieldSinkGrid(&sinks);
+        UnloadChargeArrays(&arrays);
+        free(points);
+        free(charges);
+    }
+
+    printf("\n%8s %6s %10s %10s %10s %10s %8s %8s %10s %10s %10s %10s %12s\n", "charges", "order", "build s", "direct s", "tree s", "fmm s", 
+           "vs dir", "vs tree", "max rel", "err/bound", "mean deg", "max deg", "mean drift");
+    static const int fmmCounts[] = { 100000, 150000, MAX_BENCH_CHARGES };
+    for (int c = 0; c < (int)(sizeof(fmmCounts) / sizeof(fmmCounts[0])); c++) {
+        int count = fmmCounts[c];
+        Charge *charges = malloc(count * sizeof(Charge));
+        Vector3 *points = malloc(BENCH_POINTS * sizeof(Vector3));
+        ChargeArrays arrays = { 0 };
+        FieldSinkGrid sinks = { 0 };
+        FieldTree tree = { 0 };
+        if (!charges || !points) return 1;
+
+        srand(12345 + count);
+        BuildScene(charges, count, points);
+        SyncChargeArrays(&arrays, charges, count, 0);
+        SyncFieldSinkGrid(&sinks, charges, count, 0);
+        SyncFieldTree(&tree, charges, count, 0);
+
+        Vector3 seeds[BENCH_LINES], directEnds[BENCH_LINES], treeEnds[BENCH_LINES], fmmEnds[BENCH_LINES];
+        for (int line = 0; line < BENCH_LINES; line++) {
+            int source = (2 * (line / FIELD_PACKET_LANES)) % count;
+            seeds[line] = (Vector3){ charges[source].position.x + RandomRange(-0.3f, 0.3f), charges[source].position.y + RandomRange(-0.3f, 0.3f),
+                                     charges[source].position.z + RandomRange(-0.3f, 0.3f) };
+        }
+        double directTime = TracePacketLines(&arrays, &sinks, NULL, NULL, NULL, seeds, directEnds);
+        double treeTime = TracePacketLines(&arrays, &sinks, &tree, NULL, NULL, seeds, treeEnds);
+
+        // Every order at the smaller count, the default one at the largest
+        for (int order = 2; order <= FIELD_FMM_MAX_ORDER; order += 2) {
+            if (c > 0 && order != FIELD_FMM_DEFAULT_ORDER) continue;
+            FieldFmm fmm = { 0 };
+            double buildStart = BenchClock();
+            SyncFieldFmm(&fmm, charges, count, order, 0);
+            double buildTime = BenchClock() - buildStart;
+
+            double fmmTime = TracePacketLines(&arrays, &sinks, NULL, &fmm, NULL, seeds, fmmEnds);
+            double meanAngle, maxAngle, relative, boundRatio, meanDrift = 0.0;
+            boundFailures += MeasureFmmError(&arrays, &fmm, points, &meanAngle, &maxAngle, &relative, &boundRatio);
+            for (int line = 0; line < BENCH_LINES; line++) {
+                Vector3 a = directEnds[line], b = fmmEnds[line];
+                meanDrift += sqrt(pow(a.x - b.x, 2) + pow(a.y - b.y, 2) + pow(a.z - b.z, 2)) / BENCH_LINES;
+            }
+
+            printf("%8d %6d %10.2f %10.3f %10.3f %10.3f %7.2fx %7.2fx %10.2e %10.2e %10.2e %10.2e %12.2e\n", count, order, buildTime, 
+                   directTime, treeTime, fmmTime, directTime / fmmTime, treeTime / fmmTime, relative, boundRatio, 
+                   meanAngle, maxAngle, meanDrift);
+            UnloadFieldFmm(&fmm);
+        }
+
+        UnloadFieldTree(&tree);
+        UnloadFieldSinkGrid(&sinks);
+        UnloadChargeArrays(&arrays);
+        free(points);
+        free(charges);
+    }
+
+    // Whole traces through the tracer, which builds the tree or the expansions
+    // itself as the app does after every charge edit
+    printf("\n%8s %12s %12s %8s\n", "charges", "tree trace s", "fmm trace s", "vs tree");
+    for (int c = 0; c < (int)(sizeof(fmmCounts) / sizeof(fmmCounts[0])); c++) {
+        int count = fmmCounts[c];
+        Charge *charges = malloc(count * sizeof(Charge));
+        Vector3 *points = malloc(BENCH_POINTS * sizeof(Vector3));
+        LineSet lines = { 0 };
+        long long evaluations;
+        if (!charges || !points) return 1;
+
+        srand(12345 + count);
+        BuildScene(charges, count, points);
+        TraceQuality quality = BenchQuality(FIELD_LINE_DEFAULT_TOLERANCE, FIELD_PRECISION_EXACT);
+        quality.treeTheta = BENCH_TREE_THETA;
+        double treeTime = RunTracer(charges, count, quality, &lines, &evaluations);
+        quality.treeTheta = 0.0f;
+        quality.fmmOrder = FIELD_FMM_DEFAULT_ORDER;
+        double fmmTime = RunTracer(charges, count, quality, &lines, &evaluations);
+        printf("%8d %12.2f %12.2f %7.2fx\n", count, treeTime, fmmTime, treeTime / fmmTime);
+
+        UnloadLineSet(&lines);
+        free(points);
+        free(charges);
+    }
+
+    printf("\n%8s %6s %10s %10s %10s %8s %10s %10s %12s\n", "charges", "res", "build s", "direct s", "lattice s", "speedup",
+           "mean deg", "max deg", "mean drift");
+    static const int latticeCounts[] = { 4, 100, 1000, FIELD_TREE_MIN_CHARGES };
+    static const int latticeResolutions[] = { 64, 96, 128 };
+    for (int c = 0; c < (int)(sizeof(latticeCounts) / sizeof(latticeCounts[0])); c++) {
+        int count = latticeCounts[c];
+        Charge *charges = malloc(count * sizeof(Charge));
+        Vector3 *points = malloc(BENCH_POINTS * sizeof(Vector3));
+        ChargeArrays arrays = { 0 };
+        FieldSinkGrid sinks = { 0 };
+        if (!charges || !points) return 1;
+
+        srand(12345 + count);
+        BuildScene(charges, count, points);
+        SyncChargeArrays(&arrays, charges, count, 0);
+        SyncFieldSinkGrid(&sinks, charges, count, 0);
+
+        Vector3 seeds[BENCH_LINES], directEnds[BENCH_LINES], latticeEnds[BENCH_LINES];
+        for (int line = 0; line < BENCH_LINES; line++) {
+            int source = (2 * (line / FIELD_PACKET_LANES)) % count;
+            seeds[line] = (Vector3){ charges[source].position.x + RandomRange(-0.3f, 0.3f), charges[source].position.y + RandomRange(-0.3f, 0.3f),
+                                     charges[source].position.z + RandomRange(-0.3f, 0.3f) };
+        }
+        double directTime = TracePacketLines(&arrays, &sinks, NULL, NULL, NULL, seeds, directEnds);
+
+        for (int r = 0; r < (int)(sizeof(latticeResolutions) / sizeof(latticeResolutions[0])); r++) {
+            FieldLattice lattice = { 0 };
+            double buildStart = BenchClock();
+            SyncFieldLattice(&lattice, charges, count, latticeResolutions[r], 0, 0, EvaluateBenchPacket, &arrays);
+            double buildTime = BenchClock() - buildStart;
+
+            double latticeTime = TracePacketLines(&arrays, &sinks, NULL, NULL, &lattice, seeds, latticeEnds);
+            double meanAngle, maxAngle, meanDrift = 0.0;
+            MeasureLatticeAngle(&arrays, &lattice, points, &meanAngle, &maxAngle);
+            for (int line = 0; line < BENCH_LINES; line++) {
+                Vector3 a = directEnds[line], b = latticeEnds[line];
+                meanDrift += sqrt(pow(a.x - b.x, 2) + pow(a.y - b.y, 2) + pow(a.z - b.z, 2)) / BENCH_LINES;
+            }
+
+            printf("%8d %6d %10.2f %10.3f %10.3f %7.2fx %10.2e %10.2e %12.2e\n", count, latticeResolutions[r], buildTime, directTime,
+                   latticeTime, directTime / latticeTime, meanAngle, maxAngle, meanDrift);
+            UnloadFieldLattice(&lattice);
+        }
+
+        UnloadFieldSinkGrid(&sinks);
+        UnloadChargeArrays(&arrays);
+        free(points);
+        free(charges);
+    }
+
+    if (failures) printf("\n%d kernel checks above FIELD_KERNEL_TOLERANCE\n", failures);
+    if (boundFailures) printf("\n%d multipole field errors above FieldFmmErrorBound\n", boundFailures);
+    return failures || boundFailures ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+#ifndef FIELD_H
+#define FIELD_H
+
+#include "raylib.h"
+
+// Each sign block of ChargeArrays is padded to a multiple of this many charges
+// (one AVX-512 register of floats) with zero charges far outside the scene
+#define CHARGE_BLOCK_ALIGNMENT 16
+#define CHARGE_PADDING_DISTANCE 1.0e6f
+
+typedef struct Charge {
+    Vector3 position;
+    float value;
+} 
+Charge;
+
+// Structure-of-arrays mirror of a charge set, sources first, so the field
+// kernels stream through contiguous memory in two branch-free loops
+typedef struct ChargeArrays {
+    float *x;
+    float *y;
+    float *z;
+    float *q;
+    int sourceCount;            // real charges in [0, sourceCount)
+    int sinkOffset;             // start of the sink block (sourceCount rounded up)
+    int sinkCount;              // real charges in [sinkOffset, sinkOffset + sinkCount)
+    int count;                  // padded length of every array
+    int capacity;
+    unsigned int chargeVersion; // charge edit the mirror was built from, 0 if unknown
+} 
+ChargeArrays;
+
+// A point is inside a sink once this close (squared) to a negative charge
+#define FIELD_SINK_RADIUS_SQ 0.04f
+
+// Net field at a point plus the bookkeeping the tracer needs from the same pass.
+// The nearest-source distance stays squared, the r2 the kernel already has;
+// callers take the root once per point (sqrt is monotonic, so it equals the
+// nearest r). Sinks are looked up in a FieldSinkGrid instead, outside the
+// charge loop.
+typedef struct FieldSample {
+    float x, y, z;
+    float minSourceDistSq;      // nearest positive charge, 1e8 if none
+} 
+FieldSample;
+
+typedef enum FieldKernelId {
+    FIELD_KERNEL_SCALAR = 0,
+    FIELD_KERNEL_SSE2,
+    FIELD_KERNEL_AVX2,
+    FIELD_KERNEL_AVX512,
+    FIELD_KERNEL_SIMD128,       // WebAssembly SIMD, only in builds made with -msimd128
+    FIELD_KERNEL_COUNT
+} 
+FieldKernelId;
+
+// How the kernels get 1/r: the exact sqrt and divide, a reciprocal square root
+// estimate refined by one Newton step, or the bare estimate. Chosen per call,
+// so traces running on another thread keep the precision they started with.
+typedef enum FieldPrecision {
+    FIELD_PRECISION_EXACT = 0,
+    FIELD_PRECISION_RSQRT_NEWTON,
+    FIELD_PRECISION_RSQRT,
+    FIELD_PRECISION_COUNT
+} 
+FieldPrecision;
+
+typedef void (*FieldKernel)(const ChargeArrays *charges, Vector3 p, FieldPrecision precision, FieldSample *out);
+
+// Up to FIELD_PACKET_LANES points (field-line heads) evaluated in lockstep: each
+// charge is broadcast once and applied to every lane. Lanes [0, count) are live;
+// per lane the result is bitwise the scalar kernel's, as the sum order is the same.
+#define FIELD_PACKET_LANES 16
+
+typedef struct FieldPacket {
+    float x[FIELD_PACKET_LANES];
+    float y[FIELD_PACKET_LANES];
+    float z[FIELD_PACKET_LANES];
+    int count;
+    float ex[FIELD_PACKET_LANES];
+    float ey[FIELD_PACKET_LANES];
+    float ez[FIELD_PACKET_LANES];
+    float minSourceDistSq[FIELD_PACKET_LANES];
+} 
+FieldPacket;
+
+typedef void (*FieldPacketKernel)(const ChargeArrays *charges, FieldPacket *packet, FieldPrecision precision);
+
+// Scenes with up to this many real charges can use packet kernels compiled for
+// their exact count (fully unrolled); larger ones use the generic charge loop
+#define FIELD_FIXED_COUNT_MAX 16
+
+typedef enum FieldFixedCountMode {
+    FIELD_FIXED_COUNT_OFF = 0,      // always the generic loop
+    FIELD_FIXED_COUNT_MEASURED,     // only counts measured faster on the active kernel (default)
+    FIELD_FIXED_COUNT_ALL           // every count, for benchmarking
+} 
+FieldFixedCountMode;
+
+// Rebuilds the mirror unless it already holds chargeVersion (0 always rebuilds)
+void SyncChargeArrays(ChargeArrays *arrays, const Charge *charges, int count, unsigned int chargeVersion);
+void UnloadChargeArrays(ChargeArrays *arrays);
+
+// Picks the widest kernel the CPU (and OS) supports, or the SIMD128 kernel in a
+// -msimd128 web build; the scalar kernel is used until this runs and on targets
+// without vector variants. Selecting a kernel (here or with SetFieldKernel)
+// times its exact-count variants once, for FIELD_FIXED_COUNT_MEASURED.
+void InitFieldKernels(void);
+bool IsFieldKernelSupported(FieldKernelId id);
+void SetFieldKernel(FieldKernelId id);
+FieldKernelId GetFieldKernel(void);
+const char *GetFieldKernelName(FieldKernelId id);
+void SetFieldFixedCountMode(FieldFixedCountMode mode);
+FieldFixedCountMode GetFieldFixedCountMode(void);
+bool IsFieldFixedCountMeasuredFaster(FieldKernelId id, int count);
+
+const char *GetFieldPrecisionName(FieldPrecision precision);
+
+// In exact precision, vector kernels reorder the sums, so their field matches
+// the scalar path to within FIELD_KERNEL_TOLERANCE times the summed magnitude of
+// the individual contributions (near-cancelling fields lose relative precision
+// either way); nearest-source distances match exactly. Needs
+// -ffp-contract=off.
+#define FIELD_KERNEL_TOLERANCE 1.0e-5f
+void EvaluateField(const ChargeArrays *charges, Vector3 p, FieldPrecision precision, FieldSample *out);
+void EvaluateFieldPacket(const ChargeArrays *charges, FieldPacket *packet, FieldPrecision precision);
+
+#endif // FIELD_H
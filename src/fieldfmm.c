@@ -0,0 +1,568 @@
+#include "fieldfmm.h"
+#include "fieldtask.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Multipole-to-local needs derivatives of 1/r up to twice the expansion order
+#define MAX_DERIVATIVE (2 * FIELD_FMM_MAX_ORDER)
+#define COEFFICIENTS(order) (((order) + 1) * ((order) + 2) * ((order) + 3) / 6)
+#define MAX_COEFFICIENTS COEFFICIENTS(FIELD_FMM_MAX_ORDER)
+#define MAX_DERIVATIVES COEFFICIENTS(MAX_DERIVATIVE)
+
+// Multi-indices (i, j, k) of the Cartesian Taylor coefficients, in order of total
+// degree so the coefficients of any order are a prefix of the list
+typedef struct MultiIndex {
+    unsigned char i, j, k, degree;
+    short lower[3];             // index minus one along each axis, -1 if that would be negative
+    short lower2[3];            // index minus two along each axis
+    short parent;               // monomial recurrence: this index is parent + axis
+    unsigned char axis;
+}
+MultiIndex;
+
+static MultiIndex indices[MAX_DERIVATIVES];
+static short indexOf[MAX_DERIVATIVE + 1][MAX_DERIVATIVE + 1][MAX_DERIVATIVE + 1];
+static double binomial[MAX_DERIVATIVE + 1][MAX_DERIVATIVE + 1];
+static double factorial[MAX_DERIVATIVES];  // i! j! k!
+static double recurrenceFirst[MAX_DERIVATIVE + 1], recurrenceSecond[MAX_DERIVATIVE + 1];
+
+// Multipole-to-local: local coefficient b gains multipole a times the derivative
+// m2lDerivative[b][a] = a + b of 1/r
+static short m2lDerivative[MAX_COEFFICIENTS][MAX_COEFFICIENTS];
+
+// Built on first use, from the tracing thread (or the benchmark's main thread)
+static bool tablesReady = false;
+
+static void InitFmmTables(void) {
+    if (tablesReady) return;
+
+    int n = 0;
+    for (int degree = 0; degree <= MAX_DERIVATIVE; degree++)
+        for (int i = degree; i >= 0; i--)
+            for (int j = degree - i; j >= 0; j--) {
+                indices[n] = (MultiIndex){ .i = i, .j = j, .k = degree - i - j, .degree = degree };
+                indexOf[i][j][degree - i - j] = n++;
+            }
+
+    for (int m = 0; m < MAX_DERIVATIVES; m++) {
+        MultiIndex *index = &indices[m];
+        int c[3] = { index->i, index->j, index->k };
+        index->parent = -1;
+        for (int axis = 2; axis >= 0; axis--) {
+            int d1[3] = { c[0], c[1], c[2] }, d2[3] = { c[0], c[1], c[2] };
+            d1[axis] -= 1;
+            d2[axis] -= 2;
+            index->lower[axis] = d1[axis] >= 0 ? indexOf[d1[0]][d1[1]][d1[2]] : -1;
+            index->lower2[axis] = d2[axis] >= 0 ? indexOf[d2[0]][d2[1]][d2[2]] : -1;
+            if (index->lower[axis] >= 0) {
+                index->parent = index->lower[axis];
+                index->axis = axis;
+            }
+        }
+    }
+
+    for (int a = 0; a <= MAX_DERIVATIVE; a++) {
+        binomial[a][0] = 1.0;
+        for (int b = 1; b <= a; b++) binomial[a][b] = binomial[a - 1][b - 1] + binomial[a - 1][b];
+    }
+
+    for (int n = 1; n <= MAX_DERIVATIVE; n++) {
+        recurrenceFirst[n] = (2.0 * n - 1.0) / n;
+        recurrenceSecond[n] = (n - 1.0) / n;
+    }
+
+    for (int m = 0; m < MAX_DERIVATIVES; m++) {
+        const MultiIndex *index = &indices[m];
+        factorial[m] = 1.0;
+        for (int f = 2; f <= index->i; f++) factorial[m] *= f;
+        for (int f = 2; f <= index->j; f++) factorial[m] *= f;
+        for (int f = 2; f <= index->k; f++) factorial[m] *= f;
+    }
+
+    for (int b = 0; b < MAX_COEFFICIENTS; b++)
+        for (int a = 0; a < MAX_COEFFICIENTS; a++) {
+            const MultiIndex *ia = &indices[a], *ib = &indices[b];
+            m2lDerivative[b][a] = indexOf[ia->i + ib->i][ia->j + ib->j][ia->k + ib->k];
+        }
+
+    tablesReady = true;
+}
+
+// d^m for the first count multi-indices
+static void Monomials(double dx, double dy, double dz, int count, double *out) {
+    double d[3] = { dx, dy, dz };
+    out[0] = 1.0;
+    for (int m = 1; m < count; m++) out[m] = out[indices[m].parent] * d[indices[m].axis];
+}
+
+// Taylor coefficients of 1/|r| about r, D_m = (1/m!) d^m/dr^m (1/|r|), for the
+// first count multi-indices, by the recurrence
+// n r^2 D_m = -(2n - 1) sum_i r_i D_{m - e_i} - (n - 1) sum_i D_{m - 2e_i}
+static void Derivatives(double rx, double ry, double rz, int count, double *out) {
+    double r[3] = { rx, ry, rz };
+    double invR2 = 1.0 / (rx*rx + ry*ry + rz*rz);
+    out[0] = sqrt(invR2);
+
+    for (int m = 1; m < count; m++) {
+        const MultiIndex *index = &indices[m];
+        double first = 0.0, second = 0.0;
+        for (int axis = 0; axis < 3; axis++) {
+            if (index->lower[axis] >= 0) first += r[axis] * out[index->lower[axis]];
+            if (index->lower2[axis] >= 0) second += out[index->lower2[axis]];
+        }
+        int n = index->degree;
+        out[m] = -(recurrenceFirst[n] * first + recurrenceSecond[n] * second) * invR2;
+    }
+}
+
+// Field error of one well-separated pair anywhere in the target cell, per unit of
+// the source cell's total |q|. With rho = (a + b) / d, the dropped Taylor terms of
+// total degree m > order contribute at most m rho^(m - 1) / d^2 to |E|, since the
+// m-th directional derivative of 1/r is bounded by m! / r^(m + 1); summed over m,
+// rho^order ((order + 1) - order rho) / ((1 - rho)^2 d^2).
+static float PairErrorBound(int order, float rho, float d) {
+    return powf(rho, order) * ((order + 1) - order * rho) / ((1.0f - rho) * (1.0f - rho) * d * d);
+}
+
+float FieldFmmErrorBound(const FieldFmm *fmm, Vector3 p) {
+    if (fmm->cellCount == 0) return INFINITY;
+    const FieldFmmCell *c = fmm->cells;
+    if (fabsf(p.x - c->cx) > c->half || fabsf(p.y - c->cy) > c->half || fabsf(p.z - c->cz) > c->half) return INFINITY;
+    while (c->child >= 0) c = &fmm->cells[c->child + (p.x >= c->cx) + 2 * (p.y >= c->cy) + 4 * (p.z >= c->cz)];
+    return c->errorBound;
+}
+
+void UnloadFieldFmm(FieldFmm *fmm) {
+    UnloadFieldTree(&fmm->sources);
+    free(fmm->sourceRadius);
+    free(fmm->sourceCharge);
+    free(fmm->multipoles);
+    free(fmm->cells);
+    free(fmm->locals);
+    free(fmm->near);
+    *fmm = (FieldFmm){ 0 };
+}
+
+// Multipole moments M_m = sum q d^m about the node's centre (d = charge - centre),
+// straight from the node's charges and stored as (-1)^|m| M_m / m! for the
+// multipole-to-local pass, the radius of the sphere holding them and their total |q|
+static void ComputeMultipoles(void *data, const void *context, int node) {
+    (void)context;
+    FieldFmm *fmm = data;
+    const FieldTree *tree = &fmm->sources;
+    const FieldTreeNode *source = &tree->nodes[node];
+    double *moments = fmm->multipoles + (size_t)node * fmm->coefficientCount;
+    double monomials[MAX_COEFFICIENTS];
+    float radiusSq = 0.0f, absCharge = 0.0f;
+
+    memset(moments, 0, fmm->coefficientCount * sizeof(double));
+    for (int k = source->first; k < source->first + source->count; k++) {
+        double dx = tree->x[k] - source->cx, dy = tree->y[k] - source->cy, dz = tree->z[k] - source->cz;
+        Monomials(dx, dy, dz, fmm->coefficientCount, monomials);
+        for (int m = 0; m < fmm->coefficientCount; m++) moments[m] += tree->q[k] * monomials[m];
+
+        float d2 = (float)(dx*dx + dy*dy + dz*dz);
+        radiusSq = d2 > radiusSq ? d2 : radiusSq;
+        absCharge += fabsf(tree->q[k]);
+    }
+    for (int m = 0; m < fmm->coefficientCount; m++) moments[m] *= (indices[m].degree % 2 ? -1.0 : 1.0) / factorial[m];
+
+    // Rounded up a little so the sphere really holds every charge
+    fmm->sourceRadius[node] = sqrtf(radiusSq) * 1.0001f;
+    fmm->sourceCharge[node] = absCharge;
+}
+
+// Growable list of (target cell, source node) pairs
+typedef struct PairList {
+    int *cell;
+    int *node;
+    int count;
+    int capacity;
+}
+PairList;
+
+static bool PushPair(PairList *list, int cell, int node) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 1024;
+        int *cells = realloc(list->cell, capacity * sizeof(int));
+        if (!cells) return false;
+        list->cell = cells;
+        int *nodes = realloc(list->node, capacity * sizeof(int));
+        if (!nodes) return false;
+        list->node = nodes;
+        list->capacity = capacity;
+    }
+
+    list->cell[list->count] = cell;
+    list->node[list->count++] = node;
+    return true;
+}
+
+static void FreePairList(PairList *list) {
+    free(list->cell);
+    free(list->node);
+    *list = (PairList){ 0 };
+}
+
+// Gives the cell eight children, one per octant (bit 0 x, bit 1 y, bit 2 z set for
+// the upper half). May move fmm->cells.
+static bool SplitCell(FieldFmm *fmm, int cell) {
+    if (fmm->cellCount + 8 > fmm->cellCapacity) {
+        int capacity = fmm->cellCapacity ? fmm->cellCapacity * 2 : 256;
+        FieldFmmCell *cells = realloc(fmm->cells, capacity * sizeof(FieldFmmCell));
+        if (!cells) return false;
+        fmm->cells = cells;
+        fmm->cellCapacity = capacity;
+    }
+
+    FieldFmmCell parent = fmm->cells[cell];
+    float quarter = 0.5f * parent.half;
+    int child = fmm->cellCount;
+    for (int o = 0; o < 8; o++) {
+        fmm->cells[child + o] = (FieldFmmCell){
+            parent.cx + (o & 1 ? quarter : -quarter), parent.cy + (o & 2 ? quarter : -quarter), parent.cz + (o & 4 ? quarter : -quarter),
+            quarter, -1, 0, 0, 1.0e8f, 0.0f
+        };
+    }
+    fmm->cellCount += 8;
+    fmm->cells[cell].child = child;
+    return true;
+}
+
+// Dual walk: a well-separated pair becomes a multipole-to-local translation, a
+// source leaf that is too near is summed directly, otherwise the larger of the
+// two is split (target cells are made as needed, down to FIELD_FMM_MAX_DEPTH)
+static bool Interact(FieldFmm *fmm, int cell, int depth, int node, PairList *far, PairList *near) {
+    const FieldTreeNode *source = &fmm->sources.nodes[node];
+    FieldFmmCell *target = &fmm->cells[cell];
+    float dx = target->cx - source->cx, dy = target->cy - source->cy, dz = target->cz - source->cz;
+    float d = sqrtf(dx*dx + dy*dy + dz*dz);
+    float a = target->half * 1.7320508f, b = fmm->sourceRadius[node];
+    float gap = d - a - b;
+
+    if (a + b < FIELD_FMM_THETA * d && gap * gap >= FIELD_SINK_RADIUS_SQ) {
+        if (source->hasSources && gap * gap < target->farSourceSq) target->farSourceSq = gap * gap;
+        target->errorBound += fmm->sourceCharge[node] * PairErrorBound(fmm->order, (a + b) / d, d);
+        return PushPair(far, cell, node);
+    }
+
+    if (source->child < 0) return PushPair(near, cell, node);
+
+    if (a > b && depth < FIELD_FMM_MAX_DEPTH) {
+        if (target->child < 0 && !SplitCell(fmm, cell)) return false;
+        int child = fmm->cells[cell].child;
+        for (int o = 0; o < 8; o++)
+            if (!Interact(fmm, child + o, depth + 1, node, far, near)) return false;
+        return true;
+    }
+
+    for (int c = source->child; c < source->child + source->childCount; c++)
+        if (!Interact(fmm, cell, depth, c, far, near)) return false;
+    return true;
+}
+
+// Pairs grouped by target cell: cell c's are at order[first[c], first[c + 1])
+typedef struct PairGroups {
+    const PairList *pairs;
+    int *first;
+    int *order;
+}
+PairGroups;
+
+static bool GroupPairs(const PairList *pairs, int cellCount, PairGroups *groups) {
+    groups->pairs = pairs;
+    groups->first = calloc(cellCount + 1, sizeof(int));
+    groups->order = malloc((pairs->count + 1) * sizeof(int));
+    if (!groups->first || !groups->order) return false;
+
+    for (int p = 0; p < pairs->count; p++) groups->first[pairs->cell[p] + 1]++;
+    for (int c = 0; c < cellCount; c++) groups->first[c + 1] += groups->first[c];
+
+    int *next = malloc((cellCount + 1) * sizeof(int));
+    if (!next) return false;
+    memcpy(next, groups->first, (cellCount + 1) * sizeof(int));
+    for (int p = 0; p < pairs->count; p++) groups->order[next[pairs->cell[p]]++] = p;
+    free(next);
+    return true;
+}
+
+static void FreePairGroups(PairGroups *groups) {
+    free(groups->first);
+    free(groups->order);
+}
+
+// Local expansion of a cell from every multipole it is well separated from:
+// L_b = sum_a (-1)^|a| (a + b choose b) M_a D_(a + b)(cell centre - source centre),
+// summed as b! L_b = sum_a ((-1)^|a| M_a / a!) ((a + b)! D_(a + b))
+static void ComputeLocals(void *data, const void *context, int cell) {
+    FieldFmm *fmm = data;
+    const PairGroups *groups = context;
+    int count = fmm->coefficientCount, derivativeCount = COEFFICIENTS(2 * fmm->order);
+    double *local = fmm->locals + (size_t)cell * count;
+    const FieldFmmCell *target = &fmm->cells[cell];
+    double derivatives[MAX_DERIVATIVES];
+
+    memset(local, 0, count * sizeof(double));
+    for (int p = groups->first[cell]; p < groups->first[cell + 1]; p++) {
+        int node = groups->pairs->node[groups->order[p]];
+        const FieldTreeNode *source = &fmm->sources.nodes[node];
+        const double *moments = fmm->multipoles + (size_t)node * count;
+        Derivatives((double)target->cx - source->cx, (double)target->cy - source->cy, (double)target->cz - source->cz,
+                    derivativeCount, derivatives);
+        for (int n = 0; n < derivativeCount; n++) derivatives[n] *= factorial[n];
+
+        for (int b = 0; b < count; b++) {
+            const short *derivative = m2lDerivative[b];
+            double sum = 0.0;
+            for (int a = 0; a < count; a++) sum += moments[a] * derivatives[derivative[a]];
+            local[b] += sum;
+        }
+    }
+    for (int b = 0; b < count; b++) local[b] /= factorial[b];
+}
+
+// Cells in breadth-first order with each one's parent, so a level can pull its
+// parents' expansions in parallel once the level above is done
+typedef struct CellLevels {
+    int *order;
+    int *parent;
+    int offset;                 // first entry of the level being shifted
+}
+CellLevels;
+
+// Local-to-local: the child adds its parent's expansion re-centred on itself,
+// L'_g = sum over b >= g of L_b (b choose g) s^(b - g), s = child centre - parent
+// centre (exact, so the parent's error bound carries over unchanged); distance
+// and error bounds are inherited too
+static void ShiftLocal(void *data, const void *context, int index) {
+    FieldFmm *fmm = data;
+    const CellLevels *levels = context;
+    int cell = levels->order[levels->offset + index], parent = levels->parent[levels->offset + index];
+    int count = fmm->coefficientCount;
+    FieldFmmCell *child = &fmm->cells[cell];
+    const FieldFmmCell *up = &fmm->cells[parent];
+    double *local = fmm->locals + (size_t)cell * count;
+    const double *parentLocal = fmm->locals + (size_t)parent * count;
+    double shift[MAX_COEFFICIENTS];
+
+    Monomials((double)child->cx - up->cx, (double)child->cy - up->cy, (double)child->cz - up->cz, count, shift);
+    for (int b = 0; b < count; b++) {
+        const MultiIndex *ib = &indices[b];
+        if (parentLocal[b] == 0.0) continue;
+        for (int gi = 0; gi <= ib->i; gi++)
+            for (int gj = 0; gj <= ib->j; gj++)
+                for (int gk = 0; gk <= ib->k; gk++) {
+                    double scale = binomial[ib->i][gi] * binomial[ib->j][gj] * binomial[ib->k][gk];
+                    local[indexOf[gi][gj][gk]] += parentLocal[b] * scale * shift[indexOf[ib->i - gi][ib->j - gj][ib->k - gk]];
+                }
+    }
+
+    if (up->farSourceSq < child->farSourceSq) child->farSourceSq = up->farSourceSq;
+    child->errorBound += up->errorBound;
+}
+
+static bool BuildExpansions(FieldFmm *fmm) {
+    const FieldTree *tree = &fmm->sources;
+    int count = fmm->coefficientCount;
+
+    fmm->sourceRadius = malloc(tree->nodeCount * sizeof(float));
+    fmm->sourceCharge = malloc(tree->nodeCount * sizeof(float));
+    fmm->multipoles = malloc((size_t)tree->nodeCount * count * sizeof(double));
+    if (!fmm->sourceRadius || !fmm->sourceCharge || !fmm->multipoles) return false;
+    RunFieldTask(ComputeMultipoles, fmm, NULL, tree->nodeCount);
+
+    // The root cube holds every charge and the whole region lines are traced in
+    float lo = -FIELD_FMM_DOMAIN_RADIUS, hi = FIELD_FMM_DOMAIN_RADIUS;
+    const FieldTreeNode *root = &tree->nodes[0];
+    float half = fmaxf(fmaxf(fmaxf(hi, root->maxX), fmaxf(root->maxY, root->maxZ)),
+                       -fminf(fminf(lo, root->minX), fminf(root->minY, root->minZ)));
+    fmm->cellCount = 0;
+    fmm->cellCapacity = 256;
+    fmm->cells = malloc(fmm->cellCapacity * sizeof(FieldFmmCell));
+    if (!fmm->cells) return false;
+    fmm->cells[fmm->cellCount++] = (FieldFmmCell){ 0.0f, 0.0f, 0.0f, half * 1.0001f, -1, 0, 0, 1.0e8f, 0.0f };
+
+    PairList far = { 0 }, near = { 0 };
+    PairGroups farGroups = { 0 }, nearGroups = { 0 };
+    CellLevels levels = { 0 };
+    bool ok = Interact(fmm, 0, 0, 0, &far, &near) &&
+              GroupPairs(&far, fmm->cellCount, &farGroups) && GroupPairs(&near, fmm->cellCount, &nearGroups);
+
+    if (ok) {
+        fmm->locals = malloc((size_t)fmm->cellCount * count * sizeof(double));
+        fmm->near = malloc((near.count + 1) * sizeof(int));
+        levels.order = malloc(fmm->cellCount * sizeof(int));
+        levels.parent = malloc(fmm->cellCount * sizeof(int));
+        ok = fmm->locals && fmm->near && levels.order && levels.parent;
+    }
+
+    if (ok) {
+        RunFieldTask(ComputeLocals, fmm, &farGroups, fmm->cellCount);
+
+        for (int c = 0; c < fmm->cellCount; c++) {
+            fmm->cells[c].nearFirst = nearGroups.first[c];
+            fmm->cells[c].nearCount = nearGroups.first[c + 1] - nearGroups.first[c];
+        }
+        for (int p = 0; p < near.count; p++) fmm->near[p] = near.node[nearGroups.order[p]];
+        fmm->nearCount = near.count;
+
+        // Breadth-first, a level at a time: queue the next level's cells, then
+        // shift their parents' expansions into them
+        int levelStart = 0, levelEnd = 1, queued = 1;
+        levels.order[0] = 0;
+        levels.parent[0] = -1;
+        while (levelStart < levelEnd) {
+            for (int i = levelStart; i < levelEnd; i++) {
+                int child = fmm->cells[levels.order[i]].child;
+                if (child < 0) continue;
+                for (int o = 0; o < 8; o++) {
+                    levels.order[queued] = child + o;
+                    levels.parent[queued++] = levels.order[i];
+                }
+            }
+            levels.offset = levelEnd;
+            RunFieldTask(ShiftLocal, fmm, &levels, queued - levelEnd);
+            levelStart = levelEnd;
+            levelEnd = queued;
+        }
+    }
+
+    FreePairList(&far);
+    FreePairList(&near);
+    FreePairGroups(&farGroups);
+    FreePairGroups(&nearGroups);
+    free(levels.order);
+    free(levels.parent);
+    return ok;
+}
+
+static void FreeExpansions(FieldFmm *fmm) {
+    free(fmm->sourceRadius);
+    free(fmm->sourceCharge);
+    free(fmm->multipoles);
+    free(fmm->cells);
+    free(fmm->locals);
+    free(fmm->near);
+    fmm->sourceRadius = NULL;
+    fmm->sourceCharge = NULL;
+    fmm->multipoles = NULL;
+    fmm->cells = NULL;
+    fmm->locals = NULL;
+    fmm->near = NULL;
+    fmm->cellCount = fmm->cellCapacity = fmm->nearCount = 0;
+}
+
+void SyncFieldFmm(FieldFmm *fmm, const Charge *charges, int count, int order, unsigned int chargeVersion) {
+    order = order < 1 ? 1 : order > FIELD_FMM_MAX_ORDER ? FIELD_FMM_MAX_ORDER : order;
+    if (chargeVersion != 0 && fmm->chargeVersion == chargeVersion && fmm->order == order) return;
+    InitFmmTables();
+
+    // An order change keeps the source tree and redoes the expansions
+    FreeExpansions(fmm);
+    fmm->order = order;
+    fmm->coefficientCount = COEFFICIENTS(order);
+    fmm->chargeVersion = 0;
+    fmm->sources.leafSize = FIELD_FMM_LEAF_SIZE;
+    SyncFieldTree(&fmm->sources, charges, count, chargeVersion);
+    if (fmm->sources.nodeCount == 0) {
+        if (count == 0) fmm->chargeVersion = chargeVersion;
+        return;
+    }
+
+    if (!BuildExpansions(fmm)) {
+        FreeExpansions(fmm);
+        return;
+    }
+    fmm->chargeVersion = chargeVersion;
+}
+
+// Target cells on the lanes' paths, each with the mask of lanes passing through
+#define FIELD_FMM_PATH_CAPACITY (FIELD_PACKET_LANES * (FIELD_FMM_MAX_DEPTH + 1))
+
+// Each lane descends to its target leaf and adds the leaf's local expansion,
+// E = -grad sum_b L_b h^b with h the offset from the leaf's centre. The near
+// source leaves of every cell on the way are summed directly, once per cell for
+// all the lanes that pass through it (line heads in a packet mostly share a path).
+void EvaluateFieldFmmPacket(const FieldFmm *fmm, FieldPacket *packet) {
+    const FieldTree *tree = &fmm->sources;
+    int count = fmm->coefficientCount, gradientCount = COEFFICIENTS(fmm->order - 1);
+    FieldPacket near, outside = { 0 };
+    int outsideLane[FIELD_PACKET_LANES], leaf[FIELD_PACKET_LANES];
+    int pathCell[FIELD_FMM_PATH_CAPACITY], pathCount = 0;
+    unsigned int pathLanes[FIELD_FMM_PATH_CAPACITY];
+
+    for (int i = 0; i < FIELD_PACKET_LANES; i++) {
+        near.x[i] = i < packet->count ? packet->x[i] : 0.0f;
+        near.y[i] = i < packet->count ? packet->y[i] : 0.0f;
+        near.z[i] = i < packet->count ? packet->z[i] : 0.0f;
+        near.ex[i] = near.ey[i] = near.ez[i] = 0.0f;
+        near.minSourceDistSq[i] = 1.0e8f;
+        leaf[i] = -1;
+    }
+
+    for (int i = 0; i < packet->count; i++) {
+        float x = packet->x[i], y = packet->y[i], z = packet->z[i];
+        const FieldFmmCell *root = fmm->cells;
+        if (fmm->cellCount == 0 || fabsf(x - root->cx) > root->half || fabsf(y - root->cy) > root->half || fabsf(z - root->cz) > root->half) {
+            outside.x[outside.count] = x;
+            outside.y[outside.count] = y;
+            outside.z[outside.count] = z;
+            outsideLane[outside.count++] = i;
+            continue;
+        }
+
+        int cell = 0, p = 0;
+        for (;;) {
+            // Paths are recorded in descent order, so a shared prefix is found in step
+            while (p < pathCount && pathCell[p] != cell) p++;
+            if (p == pathCount) {
+                pathCell[pathCount] = cell;
+                pathLanes[pathCount++] = 0;
+            }
+            pathLanes[p] |= 1u << i;
+
+            const FieldFmmCell *c = &fmm->cells[cell];
+            if (c->child < 0) break;
+            cell = c->child + (x >= c->cx) + 2 * (y >= c->cy) + 4 * (z >= c->cz);
+        }
+        leaf[i] = cell;
+    }
+
+    for (int p = 0; p < pathCount; p++) {
+        const FieldFmmCell *cell = &fmm->cells[pathCell[p]];
+        for (int n = cell->nearFirst; n < cell->nearFirst + cell->nearCount; n++)
+            AccumulateFieldTreeLeaf(tree, fmm->near[n], &near, pathLanes[p]);
+    }
+
+    for (int i = 0; i < packet->count; i++) {
+        if (leaf[i] < 0) continue;
+        const FieldFmmCell *cell = &fmm->cells[leaf[i]];
+        const double *local = fmm->locals + (size_t)leaf[i] * count;
+        double monomials[MAX_COEFFICIENTS];
+        double gx = 0.0, gy = 0.0, gz = 0.0;
+        Monomials((double)packet->x[i] - cell->cx, (double)packet->y[i] - cell->cy, (double)packet->z[i] - cell->cz, gradientCount, monomials);
+        for (int g = 0; g < gradientCount; g++) {
+            const MultiIndex *index = &indices[g];
+            gx += (index->i + 1) * local[indexOf[index->i + 1][index->j][index->k]] * monomials[g];
+            gy += (index->j + 1) * local[indexOf[index->i][index->j + 1][index->k]] * monomials[g];
+            gz += (index->k + 1) * local[indexOf[index->i][index->j][index->k + 1]] * monomials[g];
+        }
+
+        packet->ex[i] = near.ex[i] - (float)gx;
+        packet->ey[i] = near.ey[i] - (float)gy;
+        packet->ez[i] = near.ez[i] - (float)gz;
+        packet->minSourceDistSq[i] = fminf(near.minSourceDistSq[i], cell->farSourceSq);
+    }
+
+    if (outside.count == 0) return;
+    EvaluateFieldTreePacket(tree, &outside, FIELD_TREE_DEFAULT_THETA);
+    for (int o = 0; o < outside.count; o++) {
+        int i = outsideLane[o];
+        packet->ex[i] = outside.ex[o];
+        packet->ey[i] = outside.ey[o];
+        packet->ez[i] = outside.ez[o];
+        packet->minSourceDistSq[i] = outside.minSourceDistSq[o];
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef FIELDFMM_H
+#define FIELDFMM_H
+
+#include "fieldtree.h"
+
+// Fast multipole evaluator for very large charge sets. Source cells of an octree
+// get Cartesian Taylor (multipole) expansions of their potential up to a chosen
+// order; a dual walk against a second octree covering the trace domain turns
+// those into local expansions of the far field (multipole-to-local), which are
+// pushed down to the target leaves. A line head then costs one local expansion
+// plus the direct sum over the few source leaves next to its target leaf,
+// whatever the charge count. The precomputation runs on every core in native
+// builds, and the tracer spreads its packets of heads over them too. Opt-in in
+// place of the tree: its evaluation is faster above about 150000 charges and far
+// more accurate, but the build it pays on every charge edit outweighs that on
+// whole traces at every scene size the app offers (see the README benchmarks).
+#define FIELD_FMM_MAX_ORDER 8
+#define FIELD_FMM_DEFAULT_ORDER 4
+#define FIELD_FMM_LEAF_SIZE 32
+#define FIELD_FMM_MAX_DEPTH 16
+#define FIELD_FMM_DOMAIN_RADIUS 50.0f  // the tracer's escape radius: target cells cover at least this cube
+
+// Source and target cells interact through expansions only when their bounding
+// spheres (radii a and b) are FIELD_FMM_THETA-separated, a + b < theta * d with d
+// the distance between their centres, and stay clear of the sink radius; nearer
+// cells are summed directly. The field error of one such interaction is at most
+// Q rho^order ((order + 1) - order rho) / ((1 - rho)^2 d^2), with Q the source
+// cell's total |q| and rho = (a + b) / d < theta; each target cell sums these over
+// its own and its ancestors' interactions, bounding the truncation error of E
+// anywhere in it (see FieldFmmErrorBound).
+#define FIELD_FMM_THETA 0.7f
+
+// Box of the target octree: children are eight contiguous cells, or -1 for a leaf
+typedef struct FieldFmmCell {
+    float cx, cy, cz;
+    float half;                 // half of the cube's side
+    int child;
+    int nearFirst;              // source leaves summed directly for points in the cell:
+    int nearCount;              // near[nearFirst, nearFirst + nearCount)
+    float farSourceSq;          // lower bound on the squared distance to any source
+                                // summed through the cell's local expansion
+    float errorBound;           // bound on the truncation error of |E| anywhere in the cell
+}
+FieldFmmCell;
+
+typedef struct FieldFmm {
+    FieldTree sources;          // source octree, FIELD_FMM_LEAF_SIZE charges per leaf
+    float *sourceRadius;        // per source node: radius of its bounds about its centre
+    float *sourceCharge;        // per source node: total |q|
+    double *multipoles;         // per source node, coefficientCount moments
+    FieldFmmCell *cells;        // target octree, root first
+    int cellCount;
+    int cellCapacity;
+    double *locals;             // per target cell, coefficientCount coefficients
+    int *near;                  // source leaf indices, grouped by target cell
+    int nearCount;
+    int order;
+    int coefficientCount;       // Taylor coefficients up to order
+    unsigned int chargeVersion; // charge edit the expansions were built from, 0 if unknown
+}
+FieldFmm;
+
+// Rebuilds trees and expansions unless they already hold chargeVersion at this
+// order (0 always rebuilds). order is clamped to [1, FIELD_FMM_MAX_ORDER].
+void SyncFieldFmm(FieldFmm *fmm, const Charge *charges, int count, int order, unsigned int chargeVersion);
+void UnloadFieldFmm(FieldFmm *fmm);
+
+// Bound on the expansions' truncation error in |E| at p (before float rounding),
+// INFINITY outside the target octree or before a build
+float FieldFmmErrorBound(const FieldFmm *fmm, Vector3 p);
+
+// Packet evaluation with the same outputs as EvaluateFieldPacket, always in exact
+// precision. Nearest-source distances are exact for directly summed charges and
+// the cell's lower bound for the rest. Points outside the target octree fall
+// back to the source tree's Barnes-Hut evaluation.
+void EvaluateFieldFmmPacket(const FieldFmm *fmm, FieldPacket *packet);
+
+#endif // FIELDFMM_H
@@ -0,0 +1,254 @@
+#include "fieldlattice.h"
+#include "fieldtask.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define LATTICE_NEAR_RADIUS 0.1f    // spacings from a charge within which a node is sampled off the node
+#define LATTICE_NEAR_SHIFT 0.25f    // ... this many spacings either side, so at least 0.15 from the charge
+
+// Short-range part at a point: Coulomb minus blob field of every charge within
+// the cutoff, the nearest source among them and the nearest charge of either
+// sign (1e8 if none)
+typedef struct ShortRange {
+    float ex, ey, ez;
+    float minSourceSq;
+    float minChargeSq;
+}
+ShortRange;
+
+static ShortRange EvaluateShortRange(const FieldLattice *lattice, float x, float y, float z) {
+    ShortRange out = { 0.0f, 0.0f, 0.0f, 1.0e8f, 1.0e8f };
+    int b = lattice->bucketsPerSide, lo[3], hi[3];
+    float p[3] = { x, y, z }, cutoffSq = lattice->cutoff * lattice->cutoff, invCutoff = 1.0f / lattice->cutoff;
+
+    for (int axis = 0; axis < 3; axis++) {
+        int bucket = (int)((p[axis] + FIELD_LATTICE_EXTENT) * invCutoff);
+        lo[axis] = bucket > 0 ? bucket - 1 : 0;
+        hi[axis] = bucket < b - 1 ? bucket + 1 : b - 1;
+    }
+
+    for (int bz = lo[2]; bz <= hi[2]; bz++)
+        for (int by = lo[1]; by <= hi[1]; by++) {
+            int row = (bz * b + by) * b;
+            for (int k = lattice->bucketStart[row + lo[0]]; k < lattice->bucketStart[row + hi[0] + 1]; k++) {
+                float rx = x - lattice->x[k];
+                float ry = y - lattice->y[k];
+                float rz = z - lattice->z[k];
+                float r2 = rx*rx + ry*ry + rz*rz;
+                if (r2 >= cutoffSq) continue;
+                if (lattice->q[k] > 0.0f) out.minSourceSq = fminf(out.minSourceSq, r2);
+                out.minChargeSq = fminf(out.minChargeSq, r2);
+                if (r2 == 0.0f) continue;   // no direction: the charge's own field is left out
+
+                // 1 - g(s), g(s) = s^3 (35 - 42 s^2 + 15 s^4) / 8 the blob's enclosed fraction
+                float rInv = 1.0f / sqrtf(r2);
+                float s = r2 * rInv * invCutoff, s2 = s * s;
+                float outside = 1.0f - s * s2 * (35.0f - 42.0f * s2 + 15.0f * s2 * s2) * 0.125f;
+                float w = lattice->q[k] * outside * rInv * rInv * rInv;
+                out.ex += w * rx;
+                out.ey += w * ry;
+                out.ez += w * rz;
+            }
+        }
+
+    return out;
+}
+
+typedef struct LatticeSampler {
+    FieldPacketEvaluator evaluate;
+    const void *context;
+}
+LatticeSampler;
+
+// Smooth field at a node a charge (nearly) sits on, where the exact and
+// short-range fields are both huge or infinite and their difference is lost to
+// rounding: the mean of the smooth field half a node shift either side along x,
+// whose linear part cancels
+static void SampleNearCharge(const FieldLattice *lattice, const LatticeSampler *sampler, float x, float y, float z, float *node) {
+    float shift = LATTICE_NEAR_SHIFT * lattice->spacing;
+    FieldPacket packet = { .x = { x - shift, x + shift }, .y = { y, y }, .z = { z, z }, .count = 2 };
+    sampler->evaluate(sampler->context, &packet);
+
+    node[0] = node[1] = node[2] = 0.0f;
+    for (int i = 0; i < 2; i++) {
+        ShortRange near = EvaluateShortRange(lattice, packet.x[i], y, z);
+        node[0] += 0.5f * (packet.ex[i] - near.ex);
+        node[1] += 0.5f * (packet.ey[i] - near.ey);
+        node[2] += 0.5f * (packet.ez[i] - near.ez);
+    }
+}
+
+// Samples one row of nodes along x, a packet at a time: the exact field minus
+// its short-range part
+static void SampleLatticeRow(void *data, const void *context, int row) {
+    FieldLattice *lattice = data;
+    const LatticeSampler *sampler = context;
+    int n = lattice->resolution;
+    float y = -FIELD_LATTICE_EXTENT + (row % n) * lattice->spacing;
+    float z = -FIELD_LATTICE_EXTENT + (row / n) * lattice->spacing;
+    float *out = lattice->nodes + (size_t)row * n * FIELD_LATTICE_CHANNELS;
+    FieldPacket packet;
+
+    for (int first = 0; first < n; first += FIELD_PACKET_LANES) {
+        packet.count = n - first < FIELD_PACKET_LANES ? n - first : FIELD_PACKET_LANES;
+        for (int i = 0; i < packet.count; i++) {
+            packet.x[i] = -FIELD_LATTICE_EXTENT + (first + i) * lattice->spacing;
+            packet.y[i] = y;
+            packet.z[i] = z;
+        }
+        sampler->evaluate(sampler->context, &packet);
+
+        for (int i = 0; i < packet.count; i++) {
+            ShortRange near = EvaluateShortRange(lattice, packet.x[i], y, z);
+            float *node = out + (size_t)(first + i) * FIELD_LATTICE_CHANNELS;
+            node[0] = packet.ex[i] - near.ex;
+            node[1] = packet.ey[i] - near.ey;
+            node[2] = packet.ez[i] - near.ez;
+            node[3] = packet.minSourceDistSq[i];
+            if (near.minChargeSq < LATTICE_NEAR_RADIUS * LATTICE_NEAR_RADIUS * lattice->spacing * lattice->spacing)
+                SampleNearCharge(lattice, sampler, packet.x[i], y, z, node);
+        }
+    }
+}
+
+void UnloadFieldLattice(FieldLattice *lattice) {
+    free(lattice->nodes);
+    free(lattice->x);
+    free(lattice->y);
+    free(lattice->z);
+    free(lattice->q);
+    free(lattice->bucketStart);
+    *lattice = (FieldLattice){ 0 };
+}
+
+// Bucket of a charge, or -1 if it is too far outside the cube to reach any point in it
+static int ChargeBucket(const FieldLattice *lattice, Vector3 position) {
+    int b = lattice->bucketsPerSide, index[3];
+    float p[3] = { position.x, position.y, position.z };
+    for (int axis = 0; axis < 3; axis++) {
+        float f = (p[axis] + FIELD_LATTICE_EXTENT) / lattice->cutoff;
+        if (!(f > -1.0f && f < b + 1.0f)) return -1;
+        index[axis] = f < 0.0f ? 0 : f >= b ? b - 1 : (int)f;
+    }
+    return (index[2] * b + index[1]) * b + index[0];
+}
+
+static bool BucketCharges(FieldLattice *lattice, const Charge *charges, int count) {
+    int buckets = lattice->bucketsPerSide * lattice->bucketsPerSide * lattice->bucketsPerSide;
+    lattice->bucketStart = calloc(buckets + 1, sizeof(int));
+    if (!lattice->bucketStart) return false;
+
+    for (int c = 0; c < count; c++) {
+        int bucket = ChargeBucket(lattice, charges[c].position);
+        if (bucket >= 0) lattice->bucketStart[bucket + 1]++;
+    }
+    for (int bucket = 0; bucket < buckets; bucket++) lattice->bucketStart[bucket + 1] += lattice->bucketStart[bucket];
+
+    int kept = lattice->bucketStart[buckets];
+    int *next = malloc(buckets * sizeof(int));
+    lattice->x = malloc((kept + 1) * sizeof(float));
+    lattice->y = malloc((kept + 1) * sizeof(float));
+    lattice->z = malloc((kept + 1) * sizeof(float));
+    lattice->q = malloc((kept + 1) * sizeof(float));
+    if (!next || !lattice->x || !lattice->y || !lattice->z || !lattice->q) {
+        free(next);
+        return false;
+    }
+
+    for (int bucket = 0; bucket < buckets; bucket++) next[bucket] = lattice->bucketStart[bucket];
+    for (int c = 0; c < count; c++) {
+        int bucket = ChargeBucket(lattice, charges[c].position);
+        if (bucket < 0) continue;
+        int k = next[bucket]++;
+        lattice->x[k] = charges[c].position.x;
+        lattice->y[k] = charges[c].position.y;
+        lattice->z[k] = charges[c].position.z;
+        lattice->q[k] = charges[c].value;
+    }
+    free(next);
+    return true;
+}
+
+void SyncFieldLattice(FieldLattice *lattice, const Charge *charges, int count, int resolution, unsigned int chargeVersion,
+                      unsigned long long evaluatorKey, FieldPacketEvaluator evaluate, const void *context) {
+    resolution = resolution < 2 ? 2 : resolution > FIELD_LATTICE_MAX_RESOLUTION ? FIELD_LATTICE_MAX_RESOLUTION : resolution;
+    if (chargeVersion != 0 && lattice->chargeVersion == chargeVersion && lattice->resolution == resolution &&
+        lattice->evaluatorKey == evaluatorKey) return;
+
+    UnloadFieldLattice(lattice);
+    int n = resolution;
+    lattice->spacing = 2.0f * FIELD_LATTICE_EXTENT / (n - 1);
+    lattice->cutoff = FIELD_LATTICE_CUTOFF_CELLS * lattice->spacing;
+    lattice->bucketsPerSide = (int)ceilf(2.0f * FIELD_LATTICE_EXTENT / lattice->cutoff);
+    lattice->nodes = malloc((size_t)n * n * n * FIELD_LATTICE_CHANNELS * sizeof(float));
+    if (!lattice->nodes || !BucketCharges(lattice, charges, count)) {
+        UnloadFieldLattice(lattice);
+        return;
+    }
+
+    lattice->resolution = n;
+    LatticeSampler sampler = { evaluate, context };
+    RunFieldTask(SampleLatticeRow, lattice, &sampler, n * n);
+    lattice->chargeVersion = chargeVersion;
+    lattice->evaluatorKey = evaluatorKey;
+}
+
+void EvaluateFieldLatticePacket(const FieldLattice *lattice, FieldPacket *packet, FieldPacketEvaluator evaluate, const void *context) {
+    FieldPacket outside = { 0 };
+    int outsideLane[FIELD_PACKET_LANES];
+    int cells = lattice->resolution - 1;
+    size_t strideX = FIELD_LATTICE_CHANNELS, strideY = lattice->resolution * strideX, strideZ = lattice->resolution * strideY;
+    float cutoffSq = lattice->cutoff * lattice->cutoff;
+
+    for (int i = 0; i < packet->count; i++) {
+        float p[3] = { packet->x[i], packet->y[i], packet->z[i] }, t[3];
+        int index[3];
+        bool inside = lattice->resolution > 0;
+        for (int axis = 0; axis < 3 && inside; axis++) {
+            float f = (p[axis] + FIELD_LATTICE_EXTENT) / lattice->spacing;
+            inside = f >= 0.0f && f < cells;
+            index[axis] = inside ? (int)f : 0;
+            t[axis] = f - index[axis];
+        }
+        if (!inside) {
+            outside.x[outside.count] = p[0];
+            outside.y[outside.count] = p[1];
+            outside.z[outside.count] = p[2];
+            outsideLane[outside.count++] = i;
+            continue;
+        }
+
+        // Blend the cell's corners along x, then y, then z
+        const float *node = lattice->nodes + ((size_t)index[2] * strideZ + index[1] * strideY + index[0] * strideX);
+        float value[FIELD_LATTICE_CHANNELS];
+        for (int c = 0; c < FIELD_LATTICE_CHANNELS; c++) {
+            const float *v = node + c;
+            float x00 = v[0] + t[0] * (v[strideX] - v[0]);
+            float x10 = v[strideY] + t[0] * (v[strideY + strideX] - v[strideY]);
+            float x01 = v[strideZ] + t[0] * (v[strideZ + strideX] - v[strideZ]);
+            float x11 = v[strideZ + strideY] + t[0] * (v[strideZ + strideY + strideX] - v[strideZ + strideY]);
+            float y0 = x00 + t[1] * (x10 - x00);
+            float y1 = x01 + t[1] * (x11 - x01);
+            value[c] = y0 + t[2] * (y1 - y0);
+        }
+
+        // A source nearer than the cutoff is one of the short-range charges, so only
+        // the distance to one beyond it is interpolated (and is at least the cutoff)
+        ShortRange near = EvaluateShortRange(lattice, p[0], p[1], p[2]);
+        packet->ex[i] = value[0] + near.ex;
+        packet->ey[i] = value[1] + near.ey;
+        packet->ez[i] = value[2] + near.ez;
+        packet->minSourceDistSq[i] = near.minSourceSq < cutoffSq ? near.minSourceSq : fmaxf(value[3], cutoffSq);
+    }
+
+    if (outside.count == 0) return;
+    evaluate(context, &outside);
+    for (int o = 0; o < outside.count; o++) {
+        int i = outsideLane[o];
+        packet->ex[i] = outside.ex[o];
+        packet->ey[i] = outside.ey[o];
+        packet->ez[i] = outside.ez[o];
+        packet->minSourceDistSq[i] = outside.minSourceDistSq[o];
+    }
+}
@@ -0,0 +1,1100 @@
+#if !defined(_POSIX_C_SOURCE)
+    #define _POSIX_C_SOURCE 200809L     // clock_gettime
+#endif
+
+#include "fieldlines.h"
+#include "fieldtask.h"
+
+#define RAYMATH_STATIC_INLINE
+#include "raymath.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#if defined(TRACE_THREADED)
+    #include <pthread.h>
+#endif
+
+// A completed trace kept for reuse, with the charges its line sources index into
+typedef struct SceneCacheEntry {
+    unsigned long long key;
+    unsigned long long lastUsed;
+    TraceQuality quality;
+    Charge *charges;
+    int numCharges;
+    LineSet lines;
+    size_t bytes;
+} 
+SceneCacheEntry;
+
+//LRU cache of completed traces, keyed by SceneKey(); only touched by the tracing thread
+static SceneCacheEntry sceneCache[SCENE_CACHE_SLOTS];
+static int sceneCacheCount = 0;
+static size_t sceneCacheBudget = 64u << 20;
+static unsigned long long sceneCacheTick = 0;
+
+static TraceStats stats = { 0 };
+
+//scene generation of the newest job handed to the tracer; older jobs are obsolete
+static atomic_uint latestGeneration = 0;
+
+#if defined(TRACE_THREADED)
+static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+//worker queue: at most one waiting job, newer submissions replace it
+static pthread_t workerThread;
+static pthread_mutex_t queueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueCond = PTHREAD_COND_INITIALIZER;
+static TraceJob queuedJob;
+static bool hasQueuedJob = false;
+static bool workerStopping = false;
+
+//double-buffered geometry: the worker fills back, the renderer reads front
+static pthread_mutex_t frontMutex = PTHREAD_MUTEX_INITIALIZER;
+static LineSet lineSets[2];
+static LineSet *frontLines = &lineSets[0];
+static LineSet *backLines = &lineSets[1];
+static bool frontPublished = false;
+static TraceState workerState = { 0 };
+#endif
+
+static void LockStats(void) {
+#if defined(TRACE_THREADED)
+    pthread_mutex_lock(&statsMutex);
+#endif
+}
+
+static void UnlockStats(void) {
+#if defined(TRACE_THREADED)
+    pthread_mutex_unlock(&statsMutex);
+#endif
+}
+
+static double TraceClock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+Color CustomColorLerp(Color c1, Color c2, float amount) {
+    if (amount <= 0.0f) return c1;
+    if (amount >= 1.0f) return c2;
+    int iAmount = (int)(amount * 256.0f);
+    int invAmount = 256 - iAmount;
+    return (Color){
+        (unsigned char)((c1.r * invAmount + c2.r * iAmount) >> 8),
+        (unsigned char)((c1.g * invAmount + c2.g * iAmount) >> 8),
+        (unsigned char)((c1.b * invAmount + c2.b * iAmount) >> 8),
+        255
+    };
+}
+
+// Same as raylib's Fade(), which this module does not link against
+static Color FadeColor(Color c, float alpha) {
+    if (alpha < 0.0f) alpha = 0.0f;
+    if (alpha > 1.0f) alpha = 1.0f;
+    c.a = (unsigned char)(255.0f * alpha);
+    return c;
+}
+
+void FreeTraceJob(TraceJob *job) {
+    free(job->charges);
+    job->charges = NULL;
+}
+
+void UnloadLineSet(LineSet *set) {
+    free(set->lines);
+    free(set->vertices);
+    free(set->segmentField);
+    *set = (LineSet){ 0 };
+}
+
+void UnloadTraceState(TraceState *state) {
+    FreeTraceJob(&state->job);
+    UnloadChargeArrays(&state->sources);
+    UnloadFieldTree(&state->tree);
+    UnloadFieldFmm(&state->fmm);
+    UnloadFieldLattice(&state->lattice);
+    UnloadFieldSinkGrid(&state->sinks);
+    for (int k = 0; k < TRACE_PACKETS; k++) {
+        for (int i = 0; i < FIELD_PACKET_LANES; i++) UnloadLineSet(&state->lanes[k][i].segments);
+        state->packets[k].count = 0;
+    }
+    state->active = false;
+}
+
+static bool ReserveLines(LineSet *set, int count) {
+    if (count <= set->lineCapacity) return true;
+
+    int newCapacity = set->lineCapacity ? set->lineCapacity : 256;
+    while (newCapacity < count) newCapacity *= 2;
+    FieldLine *grown = realloc(set->lines, newCapacity * sizeof(FieldLine));
+    if (!grown) return false;
+    set->lines = grown;
+    set->lineCapacity = newCapacity;
+    return true;
+}
+
+static bool ReserveVertices(LineSet *set, int count) {
+    if (count <= set->vertexCapacity) return true;
+
+    int newCapacity = set->vertexCapacity ? set->vertexCapacity : 4096;
+    while (newCapacity < count) newCapacity *= 2;
+    FieldLineVertex *grown = realloc(set->vertices, newCapacity * sizeof(FieldLineVertex));
+    if (!grown) return false;
+    set->vertices = grown;
+    float *grownField = realloc(set->segmentField, newCapacity / 2 * sizeof(float));
+    if (!grownField) return false;
+    set->segmentField = grownField;
+    set->vertexCapacity = newCapacity;
+    return true;
+}
+
+static bool CopyLineSet(LineSet *dst, const LineSet *src) {
+    if (!ReserveLines(dst, src->lineCount) || !ReserveVertices(dst, src->vertexCount)) return false;
+
+    memcpy(dst->lines, src->lines, src->lineCount * sizeof(FieldLine));
+    memcpy(dst->vertices, src->vertices, src->vertexCount * sizeof(FieldLineVertex));
+    memcpy(dst->segmentField, src->segmentField, src->vertexCount / 2 * sizeof(float));
+    dst->lineCount = src->lineCount;
+    dst->vertexCount = src->vertexCount;
+    dst->version = src->version;
+    dst->quality = src->quality;
+    dst->allocation = src->allocation;
+    return true;
+}
+
+static void PushLineSegment(LineSet *set, Vector3 start, Vector3 end, Color col, float field) {
+    if (!ReserveVertices(set, set->vertexCount + 2)) return;
+
+    set->segmentField[set->vertexCount / 2] = field;
+    set->vertices[set->vertexCount++] = (FieldLineVertex){ start, col };
+    set->vertices[set->vertexCount++] = (FieldLineVertex){ end, col };
+}
+
+static bool SameQuality(TraceQuality a, TraceQuality b) {
+    return a.linesPerCharge == b.linesPerCharge && a.lineBudget == b.lineBudget && a.minLinesPerSource == b.minLinesPerSource && a.length == b.length && a.tolerance == b.tolerance && 
+           a.precision == b.precision && a.treeTheta == b.treeTheta && a.fmmOrder == b.fmmOrder && 
+           a.latticeResolution == b.latticeResolution;
+}
+
+static bool SameAllocation(LineAllocation a, LineAllocation b) {
+    return a.minimum == b.minimum && a.perCharge == b.perCharge && a.capped == b.capped;
+}
+
+static int SourceLineCount(LineAllocation allocation, float charge) {
+    if (allocation.capped) return allocation.minimum + (int)(allocation.perCharge * charge);
+    int lines = (int)(allocation.perCharge * charge + 0.5);
+    return lines > allocation.minimum ? lines : allocation.minimum;
+}
+
+static LineAllocation PlanLineAllocation(const Charge *charges, int count, const TraceQuality *quality) {
+    LineAllocation allocation = { quality->minLinesPerSource > 0 ? quality->minLinesPerSource : 0, quality->linesPerCharge, false };
+    int sources = 0;
+    double charge = 0.0, lines = 0.0;
+    for (int i = 0; i < count; i++) {
+        if (charges[i].value <= 0) continue;
+        sources++;
+        charge += charges[i].value;
+        lines += fmax(allocation.minimum, floor(allocation.perCharge * charges[i].value + 0.5));
+    }
+    if (sources == 0 || lines <= quality->lineBudget) return allocation;
+
+    int budget = quality->lineBudget > 0 ? quality->lineBudget : 0;
+    if (sources * (double)allocation.minimum > budget) allocation.minimum = budget / sources;
+    allocation.capped = true;
+
+    // Shares are rounded down, so at rest / charge lines per unit they fit and at
+    // (rest + sources) / charge they no longer can; bisect for the most that fit
+    int rest = budget - sources * allocation.minimum;
+    double fits = rest / charge, overflows = (rest + sources) / charge;
+    for (int iteration = 0; iteration < 24; iteration++) {
+        double mid = 0.5 * (fits + overflows);
+        long long shares = 0;
+        for (int i = 0; i < count; i++)
+            if (charges[i].value > 0) shares += (long long)(mid * charges[i].value);
+        if (shares <= rest) fits = mid;
+        else overflows = mid;
+    }
+    allocation.perCharge = fits;
+    return allocation;
+}
+
+int CountFieldLines(const Charge *charges, int count, const TraceQuality *quality) {
+    LineAllocation allocation = PlanLineAllocation(charges, count, quality);
+    int lines = 0;
+    for (int i = 0; i < count; i++)
+        if (charges[i].value > 0) lines += SourceLineCount(allocation, charges[i].value);
+    return lines;
+}
+
+#define GOLDEN_ANGLE 2.39996322972865332   // pi (3 - sqrt 5)
+
+// Appends one untraced line per seed around a positive charge. The seeds form a
+// Fibonacci lattice: seed i sits at the middle of the i-th of count equal-area bands
+// in z, turned by the golden angle from the one before, so every seed covers
+// the same solid angle (a theta/phi grid crowds its seeds at the poles)
+static void AppendChargeSeeds(TraceState *state, int source) {
+    LineSet *set = state->target;
+    int count = SourceLineCount(state->allocation, state->job.charges[source].value);
+    float startRadius = 0.1f;
+    Vector3 center = state->job.charges[source].position;
+
+    if (!ReserveLines(set, set->lineCount + count)) return;
+
+    for (int i = 0; i < count; i++) {
+        float cosTheta = 1.0f - (2.0f * i + 1.0f) / count;
+        float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+        float phi = (float)fmod(i * GOLDEN_ANGLE, 2.0 * PI);
+
+        Vector3 seed = {
+            center.x + startRadius * sinTheta * cosf(phi),
+            center.y + startRadius * sinTheta * sinf(phi),
+            center.z + startRadius * cosTheta
+        };
+        set->lines[set->lineCount++] = (FieldLine){ seed, source, 0, 0, 0.0f, false };
+        state->pendingLines++;
+    }
+}
+
+// |dE| at p caused by an edit (superposition: new contribution minus old one)
+static float EditPerturbation(Vector3 p, ChargeEdit edit) {
+    float ex = 0, ey = 0, ez = 0;
+    Charge sides[2] = { edit.after, edit.before };
+    float signs[2] = { 1.0f, -1.0f };
+
+    for (int i = 0; i < 2; i++) {
+        if (sides[i].value == 0.0f) continue;
+        Vector3 r = Vector3Subtract(p, sides[i].position);
+        float r2 = Vector3DotProduct(r, r) + 1e-6f;
+        float s = signs[i] * sides[i].value / (r2 * sqrtf(r2));
+        ex += s * r.x; ey += s * r.y; ez += s * r.z;
+    }
+
+    return sqrtf(ex*ex + ey*ey + ez*ez);
+}
+
+// Largest |dE|/|E| an edit causes along a line, relative to the field it was
+// traced in; stops early once past limit. Samples fall every
+// PERTURBATION_SAMPLE_SPACING of arc length, however long the adaptive steps
+// and radial jumps made the segments; inside a segment the weaker of its end
+// fields stands in for the field.
+static float LinePerturbation(const LineSet *set, const FieldLine *line, ChargeEdit edit, float limit) {
+    const FieldLineVertex *vertices = set->vertices + line->firstVertex;
+    const float *field = set->segmentField + line->firstVertex / 2;
+    int segments = line->vertexCount / 2;
+    float worst = 0.0f;
+    float next = 0.0f;      // arc length into the current segment of the next sample
+
+    for (int i = 0; i < segments && worst <= limit; i++) {
+        Vector3 a = vertices[2 * i].position;
+        Vector3 b = vertices[2 * i + 1].position;
+        float length = Vector3Distance(a, b);
+        float inner = i + 1 < segments ? fminf(field[i], field[i + 1]) : field[i];
+
+        for (; next < length && worst <= limit; next += PERTURBATION_SAMPLE_SPACING) {
+            Vector3 p = Vector3Lerp(a, b, next / length);
+            worst = fmaxf(worst, EditPerturbation(p, edit) / (next == 0.0f ? field[i] : inner));
+        }
+        next = fmaxf(next - length, 0.0f);
+    }
+    if (segments > 0 && worst <= limit) {
+        Vector3 last = vertices[line->vertexCount - 1].position;
+        worst = fmaxf(worst, EditPerturbation(last, edit) / field[segments - 1]);
+    }
+    return worst;
+}
+
+static int CompareLineStart(const void *a, const void *b) {
+    return ((const FieldLine *)a)->firstVertex - ((const FieldLine *)b)->firstVertex;
+}
+
+// Keeps the lines the edit barely perturbs and queues the rest for retracing.
+// A kept line still holds the geometry of the field it was traced in, so each
+// edit's perturbation adds to its drift, and it is retraced once the sum (a
+// bound on its total relative field error) passes the tolerance.
+static void BeginSelectiveRetrace(TraceState *state) {
+    LineSet *set = state->target;
+    ChargeEdit edit = state->job.edit;
+    bool added = edit.before.value == 0.0f;
+    bool deleted = edit.after.value == 0.0f;
+    Vector3 shift = deleted || added ? Vector3Zero() : Vector3Subtract(edit.after.position, edit.before.position);
+
+    // Lines emitted by the deleted charge vanish; later sources shift down by one
+    if (deleted) {
+        int kept = 0;
+        for (int i = 0; i < set->lineCount; i++) {
+            if (set->lines[i].source == edit.index) continue;
+            if (set->lines[i].source > edit.index) set->lines[i].source--;
+            set->lines[kept++] = set->lines[i];
+        }
+        set->lineCount = kept;
+    }
+
+    // Compact the surviving geometry in place (in buffer order, which earlier
+    // selective retraces scramble); dirty lines are re-appended when traced
+    qsort(set->lines, set->lineCount, sizeof(FieldLine), CompareLineStart);
+
+    int writeVertex = 0;
+    int firstChanged = set->vertexCount;
+    for (int i = 0; i < set->lineCount; i++) {
+        FieldLine *line = &set->lines[i];
+        bool dirty;
+
+        if (!deleted && line->source == edit.index) {
+            line->seed = Vector3Add(line->seed, shift);
+            dirty = true;
+        }
+        else {
+            float tolerance = state->job.retraceTolerance;
+            line->drift += LinePerturbation(set, line, edit, tolerance - line->drift);
+            dirty = line->drift > tolerance;
+        }
+
+        if (dirty) {
+            line->traced = false;
+            line->vertexCount = 0;
+            state->pendingLines++;
+            if (writeVertex < firstChanged) firstChanged = writeVertex;
+            continue;
+        }
+
+        if (line->firstVertex != writeVertex) {
+            if (writeVertex < firstChanged) firstChanged = writeVertex;
+            memmove(set->vertices + writeVertex, set->vertices + line->firstVertex, line->vertexCount * sizeof(FieldLineVertex));
+            memmove(set->segmentField + writeVertex / 2, set->segmentField + line->firstVertex / 2, line->vertexCount / 2 * sizeof(float));
+            line->firstVertex = writeVertex;
+        }
+        writeVertex += line->vertexCount;
+    }
+
+    state->firstChangedVertex = firstChanged;
+    set->vertexCount = writeVertex;
+
+    if (added && edit.after.value > 0) AppendChargeSeeds(state, edit.index);
+}
+
+static unsigned long long HashBytes(unsigned long long hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static unsigned long long HashCharge(Charge c) {
+    // -0.0f and 0.0f must hash alike
+    float fields[4] = { c.position.x + 0.0f, c.position.y + 0.0f, c.position.z + 0.0f, c.value + 0.0f };
+    unsigned long long h = HashBytes(14695981039346656037ull, fields, sizeof(fields));
+    h ^= h >> 31; h *= 0x7fb5d329728ea185ull; h ^= h >> 27;
+    return h;
+}
+
+// Integrator settings fixed at build time that shape every traced line
+static const float traceSettings[] = {
+    FIELD_LINE_STEP_SIZE, FIELD_LINE_MIN_STEP, FIELD_LINE_MAX_STEP, FIELD_LINE_FAR_STEP_RATIO,
+    FIELD_LINE_FADE_LENGTH, FIELD_LINE_JUMP_MAX_DEVIATION, FIELD_LINE_JUMP_MIN_GAIN, FIELD_SINK_RADIUS_SQ
+};
+
+// Canonical key of the traced geometry: independent of charge order, so
+// deleting and re-adding a charge finds the old trace again. Covers every
+// setting that changes the lines, including the retrace tolerance, which bounds
+// how far kept lines may have drifted from a fresh trace.
+static unsigned long long SceneKey(const TraceJob *job) {
+    unsigned long long chargeSum = 0;
+    for (int i = 0; i < job->numCharges; i++) chargeSum += HashCharge(job->charges[i]);
+
+    unsigned long long h = 14695981039346656037ull;
+    h = HashBytes(h, &chargeSum, sizeof(chargeSum));
+    h = HashBytes(h, &job->numCharges, sizeof(job->numCharges));
+    h = HashBytes(h, &job->quality.linesPerCharge, sizeof(job->quality.linesPerCharge));
+    h = HashBytes(h, &job->quality.lineBudget, sizeof(job->quality.lineBudget));
+    h = HashBytes(h, &job->quality.minLinesPerSource, sizeof(job->quality.minLinesPerSource));
+    h = HashBytes(h, &job->quality.length, sizeof(job->quality.length));
+    h = HashBytes(h, &job->quality.tolerance, sizeof(job->quality.tolerance));
+    h = HashBytes(h, &job->quality.precision, sizeof(job->quality.precision));
+    h = HashBytes(h, &job->quality.treeTheta, sizeof(job->quality.treeTheta));
+    h = HashBytes(h, &job->quality.fmmOrder, sizeof(job->quality.fmmOrder));
+    h = HashBytes(h, &job->quality.latticeResolution, sizeof(job->quality.latticeResolution));
+    h = HashBytes(h, &job->retraceTolerance, sizeof(job->retraceTolerance));
+    h = HashBytes(h, traceSettings, sizeof(traceSettings));
+    return h;
+}
+
+// Settings that change what the exact evaluator returns (the lattice samples it)
+static unsigned long long EvaluatorKey(const TraceQuality *quality) {
+    unsigned long long h = 14695981039346656037ull;
+    h = HashBytes(h, &quality->precision, sizeof(quality->precision));
+    h = HashBytes(h, &quality->treeTheta, sizeof(quality->treeTheta));
+    h = HashBytes(h, &quality->fmmOrder, sizeof(quality->fmmOrder));
+    return h;
+}
+
+// The job's own evaluator: multipole, tree or direct sum (a FieldPacketEvaluator
+// on a TraceState)
+static void EvaluateExact(const void *context, FieldPacket *packet) {
+    const TraceState *state = context;
+    if (state->job.quality.fmmOrder > 0) EvaluateFieldFmmPacket(&state->fmm, packet);
+    else if (state->job.quality.treeTheta > 0.0f) EvaluateFieldTreePacket(&state->tree, packet, state->job.quality.treeTheta);
+    else EvaluateFieldPacket(&state->sources, packet, state->job.quality.precision);
+}
+
+static const Charge *sortChargeSet = NULL;  // set the indices passed to CompareChargeIndex refer to
+
+static int CompareChargeIndex(const void *a, const void *b) {
+    const Charge *ca = &sortChargeSet[*(const int *)a];
+    const Charge *cb = &sortChargeSet[*(const int *)b];
+    float ka[4] = { ca->value, ca->position.x, ca->position.y, ca->position.z };
+    float kb[4] = { cb->value, cb->position.x, cb->position.y, cb->position.z };
+    for (int i = 0; i < 4; i++)
+        if (ka[i] != kb[i]) return ka[i] < kb[i] ? -1 : 1;
+    return 0;
+}
+
+// Maps each charge index of a cached set onto the identical charge of the job;
+// false if the sets differ (a hash collision)
+static bool MatchChargeSets(const Charge *cached, const Charge *current, int count, int *remap) {
+    int *oldOrder = malloc(2 * (count + 1) * sizeof(int));
+    if (!oldOrder) return false;
+    int *newOrder = oldOrder + count + 1;
+    for (int i = 0; i < count; i++) oldOrder[i] = newOrder[i] = i;
+
+    sortChargeSet = cached;
+    qsort(oldOrder, count, sizeof(int), CompareChargeIndex);
+    sortChargeSet = current;
+    qsort(newOrder, count, sizeof(int), CompareChargeIndex);
+
+    bool same = true;
+    for (int i = 0; i < count && same; i++) {
+        Charge a = cached[oldOrder[i]], b = current[newOrder[i]];
+        same = a.value == b.value && a.position.x == b.position.x &&
+               a.position.y == b.position.y && a.position.z == b.position.z;
+        remap[oldOrder[i]] = newOrder[i];
+    }
+
+    free(oldOrder);
+    return same;
+}
+
+static void FreeSceneCacheEntry(SceneCacheEntry *entry) {
+    free(entry->charges);
+    UnloadLineSet(&entry->lines);
+    stats.cacheBytes -= entry->bytes;
+}
+
+// Restores a cached trace of the job's scene into the target set
+static bool LoadSceneFromCache(TraceState *state) {
+    const TraceJob *job = &state->job;
+
+    for (int i = 0; i < sceneCacheCount; i++) {
+        SceneCacheEntry *entry = &sceneCache[i];
+        if (entry->key != state->key || entry->numCharges != job->numCharges ||
+            !SameQuality(entry->quality, job->quality)) continue;
+
+        int *remap = malloc((job->numCharges + 1) * sizeof(int));
+        if (!remap) return false;
+        if (!MatchChargeSets(entry->charges, job->charges, job->numCharges, remap) ||
+            !CopyLineSet(state->target, &entry->lines)) {
+            free(remap);
+            continue;
+        }
+
+        for (int l = 0; l < state->target->lineCount; l++)
+            state->target->lines[l].source = remap[state->target->lines[l].source];
+        free(remap);
+
+        entry->lastUsed = ++sceneCacheTick;
+        return true;
+    }
+    return false;
+}
+
+// Keeps a copy of the finished target set, evicting least recently used traces
+// until it fits sceneCacheBudget
+static void StoreSceneInCache(TraceState *state) {
+    const TraceJob *job = &state->job;
+    const LineSet *set = state->target;
+    size_t bytes = job->numCharges * sizeof(Charge) + set->lineCount * sizeof(FieldLine) +
+                   set->vertexCount * (sizeof(FieldLineVertex) + sizeof(float) / 2);
+    if (bytes > sceneCacheBudget / 2) return;
+
+    LockStats();
+    while (sceneCacheCount > 0 && (sceneCacheCount == SCENE_CACHE_SLOTS || stats.cacheBytes + bytes > sceneCacheBudget)) {
+        int oldest = 0;
+        for (int i = 1; i < sceneCacheCount; i++)
+            if (sceneCache[i].lastUsed < sceneCache[oldest].lastUsed) oldest = i;
+        FreeSceneCacheEntry(&sceneCache[oldest]);
+        sceneCache[oldest] = sceneCache[--sceneCacheCount];
+    }
+    UnlockStats();
+
+    SceneCacheEntry entry = { .key = state->key, .lastUsed = ++sceneCacheTick, .quality = job->quality };
+    entry.numCharges = job->numCharges;
+    entry.charges = malloc(job->numCharges * sizeof(Charge) + 1);
+    if (!entry.charges || !CopyLineSet(&entry.lines, set)) {
+        free(entry.charges);
+        UnloadLineSet(&entry.lines);
+        return;
+    }
+    memcpy(entry.charges, job->charges, job->numCharges * sizeof(Charge));
+    entry.bytes = bytes;
+
+    LockStats();
+    stats.cacheBytes += bytes;
+    UnlockStats();
+    sceneCache[sceneCacheCount++] = entry;
+}
+
+void ClearSceneCache(void) {
+    LockStats();
+    for (int i = 0; i < sceneCacheCount; i++) FreeSceneCacheEntry(&sceneCache[i]);
+    sceneCacheCount = 0;
+    UnlockStats();
+}
+
+static void PublishProgress(const TraceState *state) {
+    LockStats();
+    stats.pendingLines = state->pendingLines;
+    stats.finishedLines = state->finishedLines;
+    stats.preview = state->job.quality.preview;
+    UnlockStats();
+}
+
+static void CountJob(bool cancelled) {
+    LockStats();
+    if (cancelled) stats.cancelledJobs++;
+    else stats.completedJobs++;
+    UnlockStats();
+}
+
+// Generations only move forward, even if a worker begins a job after a newer one was submitted
+static void AdvanceGeneration(unsigned int generation) {
+    unsigned int latest = atomic_load(&latestGeneration);
+    while (latest < generation && !atomic_compare_exchange_weak(&latestGeneration, &latest, generation)) {}
+}
+
+static bool IsObsolete(const TraceJob *job) {
+    return job->version != atomic_load(&latestGeneration);
+}
+
+// Net charge and charge centroid of the job, and how far its charges reach from
+// the centroid; only needed (and only meaningful) when the net charge is positive
+static void MeasureFarField(TraceState *state) {
+    double q = 0.0, x = 0.0, y = 0.0, z = 0.0;
+    for (int i = 0; i < state->job.numCharges; i++) {
+        Charge c = state->job.charges[i];
+        q += c.value;
+        x += c.value * c.position.x;
+        y += c.value * c.position.y;
+        z += c.value * c.position.z;
+    }
+
+    state->netCharge = (float)q;
+    state->clusterRadius = 0.0f;
+    if (q <= 0.0) return;
+
+    state->centroid = (Vector3){ (float)(x / q), (float)(y / q), (float)(z / q) };
+    for (int i = 0; i < state->job.numCharges; i++)
+        state->clusterRadius = fmaxf(state->clusterRadius, Vector3Distance(state->job.charges[i].position, state->centroid));
+}
+
+void BeginTrace(TraceState *state, TraceJob job, LineSet *target, const LineSet *base) {
+    bool selective = job.hasEdit && base->version + 1 == job.version && SameQuality(base->quality, job.quality);
+
+    // Time-sliced callers start the next job before the previous one finished
+    if (state->active) CountJob(true);
+    AdvanceGeneration(job.version);
+
+    FreeTraceJob(&state->job);
+    state->job = job;
+    state->key = SceneKey(&job);
+    state->target = target;
+    state->nextLine = 0;
+    state->pendingLines = 0;
+    state->finishedLines = 0;
+    state->firstChangedVertex = 0;
+    for (int k = 0; k < TRACE_PACKETS; k++) state->packets[k].count = 0;
+    state->active = true;
+    state->allocation = PlanLineAllocation(job.charges, job.numCharges, &job.quality);
+    MeasureFarField(state);
+
+    if (LoadSceneFromCache(state)) {
+        LockStats(); stats.cacheHits++; UnlockStats();
+        state->nextLine = target->lineCount;
+    }
+    else {
+        // Evaluators are only built for scenes that get traced; the lattice samples through them
+        LockStats(); stats.cacheMisses++; UnlockStats();
+        if (job.quality.fmmOrder > 0) SyncFieldFmm(&state->fmm, job.charges, job.numCharges, job.quality.fmmOrder, job.chargeVersion);
+        else if (job.quality.treeTheta > 0.0f) SyncFieldTree(&state->tree, job.charges, job.numCharges, job.chargeVersion);
+        else SyncChargeArrays(&state->sources, job.charges, job.numCharges, job.chargeVersion);
+        SyncFieldSinkGrid(&state->sinks, job.charges, job.numCharges, job.chargeVersion);
+        if (job.quality.latticeResolution > 0)
+            SyncFieldLattice(&state->lattice, job.charges, job.numCharges, job.quality.latticeResolution, job.chargeVersion,
+                             EvaluatorKey(&job.quality), EvaluateExact, state);
+
+        // Lines of untouched sources can only be kept if their counts stay the same
+        if (selective && SameAllocation(base->allocation, state->allocation) && (target == base || CopyLineSet(target, base))) {
+            BeginSelectiveRetrace(state);
+        } else {
+            target->lineCount = 0;
+            target->vertexCount = 0;
+
+            for (int j = 0; j < job.numCharges; j++)
+                if (job.charges[j].value > 0) AppendChargeSeeds(state, j);
+        }
+    }
+
+    target->version = 0;
+    target->quality = job.quality;
+    target->allocation = state->allocation;
+    PublishProgress(state);
+}
+
+// Moves a finished lane's segments onto the end of the target
+static void FinishLane(TraceState *state, LineCursor *lane) {
+    LineSet *set = state->target;
+    FieldLine *line = &set->lines[lane->line];
+    int count = lane->segments.vertexCount;
+
+    line->firstVertex = set->vertexCount;
+    line->vertexCount = 0;
+    if (ReserveVertices(set, set->vertexCount + count)) {
+        memcpy(set->vertices + set->vertexCount, lane->segments.vertices, count * sizeof(FieldLineVertex));
+        memcpy(set->segmentField + set->vertexCount / 2, lane->segments.segmentField, count / 2 * sizeof(float));
+        set->vertexCount += count;
+        line->vertexCount = count;
+    }
+    line->drift = 0.0f;
+    line->traced = true;
+
+    state->finishedLines++;
+    PublishProgress(state);
+}
+
+// Tops packet k up with the seeds of untraced lines
+static void FillPacket(TraceState *state, int k) {
+    LineSet *set = state->target;
+    FieldPacket *packet = &state->packets[k];
+
+    while (packet->count < FIELD_PACKET_LANES && state->nextLine < set->lineCount) {
+        int index = state->nextLine++;
+        FieldLine *line = &set->lines[index];
+        if (line->traced) continue;
+
+        LineCursor *lane = &state->lanes[k][packet->count];
+        lane->line = index;
+        lane->stage = 0;
+        lane->length = 0.0f;
+        lane->step = FIELD_LINE_STEP_SIZE;
+        lane->base = line->seed;
+        lane->sinkClearanceSq = -1.0f;
+        lane->sinkCursor.nearest = -1;
+        lane->segments.vertexCount = 0;
+        packet->x[packet->count] = line->seed.x;
+        packet->y[packet->count] = line->seed.y;
+        packet->z[packet->count] = line->seed.z;
+        packet->count++;
+    }
+}
+
+// Draws a lane's segment from its base to end, coloured by the nearest source
+// and sink at the base and faded over the line's last FIELD_LINE_FADE_LENGTH
+static void PushLaneSegment(TraceState *state, LineCursor *lane, Vector3 end) {
+    float length = state->job.quality.length;
+
+    // Colour comes from the nearest source and sink, rooted once per vertex
+    float minDistToPos = sqrtf(lane->baseSourceDistSq);
+    float minDistToNeg = sqrtf(lane->baseSinkDistSq);
+    float mix = minDistToPos / (minDistToPos + minDistToNeg + 0.001f);
+    mix = powf(mix, 0.7f);
+
+    Color col = CustomColorLerp(BLUE, RED, mix);
+    float alpha = 1.0f;
+    if (lane->length > length - FIELD_LINE_FADE_LENGTH) alpha = (length - lane->length) / FIELD_LINE_FADE_LENGTH;
+    if (minDistToNeg > 20.0f) alpha *= 0.5f;
+
+    PushLineSegment(&lane->segments, lane->base, end, FadeColor(col, 0.6f * alpha), lane->baseField);
+}
+
+#define LANE_STAGE_JUMP 4       // a lane's head is the end of a radial jump
+
+// Relative deviation |E - M| / |M| of field at p from the field M of a lone charge
+// at centre
+static float RadialDeviation(Vector3 p, Vector3 field, Vector3 centre, float charge) {
+    Vector3 r = Vector3Subtract(p, centre);
+    float r2 = Vector3DotProduct(r, r);
+    if (r2 == 0.0f || charge == 0.0f) return INFINITY;
+    Vector3 model = Vector3Scale(r, charge / (r2 * sqrtf(r2)));
+    return Vector3Length(Vector3Subtract(field, model)) * r2 / fabsf(charge);
+}
+
+// Plans an analytic step from the lane's base, where the field is field: a
+// straight jump along the ray from a charge whose field dominates, the field line
+// of that charge alone. Two charges qualify. One is the line's own source, whose
+// field falls as 1 / r^2 against the rest, roughly constant, so the relative
+// deviation e grows as (r / r0)^2. The other is the whole set seen from its charge
+// centroid, about which the dipole moment vanishes, so for points well outside
+// the set e falls as (r0 / r)^2. The line's direction is within e of the ray, so
+// reaching r1 its bearing from the charge drifts by at most the integral of e / r
+// from r0 to r1. Lines fan out from either charge, so that bearing error grows
+// with distance; the jump is the longest whose drift stays within the tolerance
+// at the edge of the trace region, solved in closed form. Returns false when no
+// jump clearly beats the lane's Runge-Kutta step.
+static bool PlanRadialJump(TraceState *state, LineCursor *lane, Vector3 field) {
+    float drift = state->job.quality.tolerance / 50.0f;
+    float remaining = state->job.quality.length - lane->length;
+    const Charge *source = &state->job.charges[state->target->lines[lane->line].source];
+    Vector3 base = lane->base;
+    float best = 0.0f, bestDeviation = 0.0f, bestR0 = 0.0f;
+    bool growing = false;
+
+    // Own source: e0 (r1^2 / r0^2 - 1) / 2 <= drift
+    float deviation = RadialDeviation(base, field, source->position, source->value);
+    if (deviation < FIELD_LINE_JUMP_MAX_DEVIATION) {
+        float r0 = Vector3Distance(base, source->position);
+        float r1 = r0 * sqrtf(1.0f + 2.0f * drift / fmaxf(deviation, 1e-12f));
+        best = r1 - r0;
+        bestDeviation = deviation;
+        bestR0 = r0;
+        growing = true;
+        lane->jumpCentre = source->position;
+        lane->jumpCharge = source->value;
+    }
+
+    // Far field: e0 (1 - r0^2 / r1^2) / 2 <= drift, reaching infinity once e0 <= 2 drift.
+    // Lines only head off to infinity when the net charge is positive.
+    float r0 = Vector3Distance(base, state->centroid);
+    if (state->netCharge > 0.0f && r0 > 2.0f * state->clusterRadius) {
+        deviation = RadialDeviation(base, field, state->centroid, state->netCharge);
+        if (deviation < FIELD_LINE_JUMP_MAX_DEVIATION) {
+            float r1 = deviation > 2.0f * drift ? r0 / sqrtf(1.0f - 2.0f * drift / deviation) : INFINITY;
+            if (r1 - r0 > best) {
+                best = r1 - r0;
+                bestDeviation = deviation;
+                bestR0 = r0;
+                growing = false;
+                lane->jumpCentre = state->centroid;
+                lane->jumpCharge = state->netCharge;
+            }
+        }
+    }
+
+    if (best < FIELD_LINE_JUMP_MIN_GAIN * lane->step) return false;
+    if (best > remaining) best = remaining;
+    float ratio = (bestR0 + best) / bestR0;
+    lane->jumpDeviation = growing ? bestDeviation * ratio * ratio : bestDeviation / (ratio * ratio);
+    Vector3 ray = Vector3Normalize(Vector3Subtract(base, lane->jumpCentre));
+    lane->next = Vector3Add(base, Vector3Scale(ray, best));
+    return true;
+}
+
+// Largest step from p: outside the charges a line's curvature falls off with the
+// distance from them, so steps may grow with it
+static float MaxStep(const TraceState *state, Vector3 p) {
+    if (state->netCharge <= 0.0f) return FIELD_LINE_MAX_STEP;
+    float r = Vector3Distance(p, state->centroid);
+    return r > 2.0f * state->clusterRadius ? fmaxf(FIELD_LINE_MAX_STEP, FIELD_LINE_FAR_STEP_RATIO * r) : FIELD_LINE_MAX_STEP;
+}
+
+// Ends the step in progress at lane->next, advanced arc length further along the
+// line: draws it (cut off where it leaves the trace region) and makes its end the
+// new base; returns false once the line has ended
+static bool AcceptStep(TraceState *state, LineCursor *lane, float advanced) {
+    Vector3 base = lane->base, next = lane->next;
+    if (Vector3DotProduct(next, next) > 2500.0f) {
+        Vector3 d = Vector3Subtract(next, base);
+        float a = Vector3DotProduct(d, d), b = Vector3DotProduct(base, d), c = Vector3DotProduct(base, base) - 2500.0f;
+        float t = (-b + sqrtf(fmaxf(b*b - a*c, 0.0f))) / a;
+        PushLaneSegment(state, lane, Vector3Add(base, Vector3Scale(d, fminf(fmaxf(t, 0.0f), 1.0f))));
+        return false;
+    }
+    PushLaneSegment(state, lane, next);
+    lane->length += advanced;
+    lane->base = next;
+    lane->stage = 0;
+    return lane->length < state->job.quality.length;
+}
+
+// Takes the field at lane i's head (a stage point of its current step) and moves
+// the head on to the next stage point; returns false once the line has ended.
+// Lines follow the unit field direction, so steps and length are arc length.
+// Each step is a Bogacki-Shampine 3(2) step: stages at the base, half way and
+// three quarters of the way, then the third-order end point, whose direction is
+// the next step's first stage. The difference to the embedded second-order
+// solution estimates the step's error; so does the sagitta of its chord, h|dk|/8,
+// so that a smoothly curving line still gets enough vertices to look round.
+// Where one charge dominates, a radial jump (PlanRadialJump) replaces the step;
+// the field at its end must confirm the deviation it predicted, else the lane
+// falls back to a Runge-Kutta step from the same base.
+static bool AdvanceLane(TraceState *state, LineCursor *lane, FieldPacket *packet, int i) {
+    float tolerance = state->job.quality.tolerance;
+    float length = state->job.quality.length;
+    Vector3 head = { packet->x[i], packet->y[i], packet->z[i] };
+    Vector3 field = { packet->ex[i], packet->ey[i], packet->ez[i] };
+
+    // A stage that reaches a sink ends the line there. The sink grid is only
+    // asked once the head has moved far enough from base to possibly reach one.
+    if (Vector3DistanceSqr(head, lane->base) > lane->sinkClearanceSq && IsInFieldSink(&state->sinks, head)) {
+        if (lane->stage > 0) PushLaneSegment(state, lane, head);
+        return false;
+    }
+
+    float magSq = Vector3DotProduct(field, field);
+    if (magSq < 1e-12f) return false;
+
+    float invMag = 1.0f / sqrtf(magSq);
+    Vector3 tangent = Vector3Scale(field, invMag);
+    float h = lane->step;
+
+    if (lane->stage == LANE_STAGE_JUMP) {
+        if (RadialDeviation(head, field, lane->jumpCentre, lane->jumpCharge) > 2.0f * lane->jumpDeviation) {
+            lane->stage = 1;
+            head = Vector3Add(lane->base, Vector3Scale(lane->tangents[0], 0.5f * h));
+            packet->x[i] = head.x; packet->y[i] = head.y; packet->z[i] = head.z;
+            return true;
+        }
+        float advanced = Vector3Distance(lane->base, lane->next);
+        if (!AcceptStep(state, lane, advanced)) return false;
+        lane->step = fminf(fminf(fmaxf(h, advanced), MaxStep(state, lane->base)), length - lane->length);
+    }
+    else if (lane->stage == 3) {
+        Vector3 *k = lane->tangents;
+        Vector3 error = Vector3Scale(Vector3Add(Vector3Add(Vector3Scale(k[0], -5.0f / 72.0f), Vector3Scale(k[1], 1.0f / 12.0f)),
+                                                Vector3Add(Vector3Scale(k[2], 1.0f / 9.0f), Vector3Scale(tangent, -1.0f / 8.0f))), h);
+        float estimate = fmaxf(Vector3Length(error), h * Vector3Length(Vector3Subtract(tangent, k[0])) * 0.125f);
+        float scale = estimate > 0.0f ? 0.9f * cbrtf(tolerance / estimate) : 5.0f;
+
+        if (estimate > tolerance && h > FIELD_LINE_MIN_STEP) {
+            lane->step = fmaxf(h * fmaxf(scale, 0.2f), FIELD_LINE_MIN_STEP);
+            lane->stage = 1;
+            head = Vector3Add(lane->base, Vector3Scale(k[0], 0.5f * lane->step));
+            packet->x[i] = head.x; packet->y[i] = head.y; packet->z[i] = head.z;
+            return true;
+        }
+
+        if (!AcceptStep(state, lane, h)) return false;
+        h *= fminf(scale, 5.0f);
+        lane->step = fminf(fminf(fmaxf(h, FIELD_LINE_MIN_STEP), MaxStep(state, lane->base)), length - lane->length);
+    }
+
+    Vector3 base = lane->base;
+    switch (lane->stage) {
+        case 0:
+            lane->tangents[0] = tangent;
+            lane->baseField = magSq * invMag;
+            lane->baseSourceDistSq = packet->minSourceDistSq[i];
+            lane->baseSinkDistSq = TrackNearestFieldSinkDistSq(&state->sinks, &lane->sinkCursor, base);
+            float clearance = 0.999f * (sqrtf(lane->baseSinkDistSq) - sqrtf(FIELD_SINK_RADIUS_SQ));
+            lane->sinkClearanceSq = clearance > 0.0f ? clearance * clearance : -1.0f;
+
+            if (PlanRadialJump(state, lane, field)) {
+                lane->stage = LANE_STAGE_JUMP;
+                packet->x[i] = lane->next.x; packet->y[i] = lane->next.y; packet->z[i] = lane->next.z;
+                return true;
+            }
+            head = Vector3Add(base, Vector3Scale(tangent, 0.5f * lane->step));
+            break;
+        case 1:
+            lane->tangents[1] = tangent;
+            head = Vector3Add(base, Vector3Scale(tangent, 0.75f * h));
+            break;
+        default: {
+            Vector3 *k = lane->tangents;
+            k[2] = tangent;
+            lane->next = Vector3Add(base, Vector3Scale(Vector3Add(Vector3Add(Vector3Scale(k[0], 2.0f / 9.0f), Vector3Scale(k[1], 1.0f / 3.0f)),
+                                                                  Vector3Scale(k[2], 4.0f / 9.0f)), h));
+            head = lane->next;
+            break;
+        }
+    }
+    lane->stage++;
+    packet->x[i] = head.x; packet->y[i] = head.y; packet->z[i] = head.z;
+    return true;
+}
+
+static void EvaluatePacketTask(void *data, const void *context, int k) {
+    (void)context;
+    TraceState *state = data;
+    if (state->packets[k].count > 0) EvaluateExact(state, &state->packets[k]);
+}
+
+// Evaluates the field at the head of every lane of the first count packets and
+// advances each lane one stage, then compacts out the lanes whose line
+// terminated; returns the evaluations made (one per lane)
+static int StepPackets(TraceState *state, int count) {
+    int evaluations = 0;
+
+    // The tree and multipole evaluators are costly enough to share out by packet
+    if (state->job.quality.latticeResolution > 0) {
+        for (int k = 0; k < count; k++)
+            if (state->packets[k].count > 0) EvaluateFieldLatticePacket(&state->lattice, &state->packets[k], EvaluateExact, state);
+    }
+    else if (state->job.quality.fmmOrder > 0 || state->job.quality.treeTheta > 0.0f) RunFieldTaskEach(EvaluatePacketTask, state, NULL, count);
+    else {
+        for (int k = 0; k < count; k++) EvaluatePacketTask(state, NULL, k);
+    }
+
+    for (int k = 0; k < count; k++) {
+        FieldPacket *packet = &state->packets[k];
+        LineCursor *lanes = state->lanes[k];
+        int live = packet->count;
+        bool finished[FIELD_PACKET_LANES];
+        for (int i = 0; i < live; i++) finished[i] = !AdvanceLane(state, &lanes[i], packet, i);
+        evaluations += live;
+
+        // Swap the last live lane into each finished one, keeping both scratch buffers
+        for (int i = 0; i < packet->count; ) {
+            if (!finished[i]) { i++; continue; }
+
+            FinishLane(state, &lanes[i]);
+            int last = --packet->count;
+            LineCursor swap = lanes[i];
+            lanes[i] = lanes[last];
+            lanes[last] = swap;
+            finished[i] = finished[last];
+            packet->x[i] = packet->x[last];
+            packet->y[i] = packet->y[last];
+            packet->z[i] = packet->z[last];
+        }
+    }
+
+    return evaluations;
+}
+
+int AdvanceTrace(TraceState *state, int maxSteps) {
+    if (!state->active) return 0;
+
+    int taken = 0;
+    while (taken < maxSteps) {
+        int count = 0;
+        for (int k = 0; k < TRACE_PACKETS; k++) {
+            FillPacket(state, k);
+            if (state->packets[k].count > 0) count = k + 1;
+        }
+        if (count == 0) break;
+        taken += StepPackets(state, count);
+    }
+    return taken;
+}
+
+bool ContinueTrace(TraceState *state, double budget) {
+    if (!state->active) return true;
+
+    LineSet *set = state->target;
+    double startTime = TraceClock();
+
+    for (;;) {
+        if (IsObsolete(&state->job)) {
+            state->active = false;
+            CountJob(true);
+            return true;
+        }
+
+        // A short quantum means neither the budget nor a cancellation waits on a long line
+        if (AdvanceTrace(state, TRACE_STEP_QUANTUM) < TRACE_STEP_QUANTUM) break;
+        if (TraceClock() - startTime > budget) return false;
+    }
+
+    // Drags and previews pass through states that are rarely revisited exactly
+    if (state->pendingLines > 0 && state->job.cacheable) StoreSceneInCache(state);
+
+    set->version = state->job.version;
+    state->active = false;
+    CountJob(false);
+    return true;
+}
+
+TraceStats GetTraceStats(void) {
+    LockStats();
+    TraceStats copy = stats;
+    UnlockStats();
+    return copy;
+}
+
+#if defined(TRACE_THREADED)
+static void *TraceWorkerMain(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&queueMutex);
+    for (;;) {
+        while (!hasQueuedJob && !workerStopping) pthread_cond_wait(&queueCond, &queueMutex);
+        if (workerStopping) break;
+
+        TraceJob job = queuedJob;
+        hasQueuedJob = false;
+        pthread_mutex_unlock(&queueMutex);
+
+        // Only the worker swaps the buffers, so it may read front without the lock
+        BeginTrace(&workerState, job, backLines, frontLines);
+        ContinueTrace(&workerState, INFINITY);
+
+        // Abandoned traces stay in back; the next job overwrites them
+        if (backLines->version == 0) {
+            pthread_mutex_lock(&queueMutex);
+            continue;
+        }
+
+        pthread_mutex_lock(&frontMutex);
+        LineSet *finished = backLines;
+        backLines = frontLines;
+        frontLines = finished;
+        frontPublished = true;
+        pthread_mutex_unlock(&frontMutex);
+
+        pthread_mutex_lock(&queueMutex);
+    }
+    pthread_mutex_unlock(&queueMutex);
+
+    return NULL;
+}
+
+void StartTraceWorker(void) {
+    workerStopping = false;
+    pthread_create(&workerThread, NULL, TraceWorkerMain, NULL);
+}
+
+void StopTraceWorker(void) {
+    pthread_mutex_lock(&queueMutex);
+    workerStopping = true;
+    atomic_store(&latestGeneration, 0);     // abandon the trace in flight
+    if (hasQueuedJob) FreeTraceJob(&queuedJob);
+    hasQueuedJob = false;
+    pthread_cond_signal(&queueCond);
+    pthread_mutex_unlock(&queueMutex);
+
+    pthread_join(workerThread, NULL);
+    UnloadTraceState(&workerState);
+    UnloadLineSet(&lineSets[0]);
+    UnloadLineSet(&lineSets[1]);
+    ClearSceneCache();
+}
+
+void SubmitTraceJob(TraceJob job) {
+    pthread_mutex_lock(&queueMutex);
+    if (hasQueuedJob) {
+        FreeTraceJob(&queuedJob);
+        CountJob(true);
+    }
+    // Tells a worker mid-trace to drop its line loop
+    AdvanceGeneration(job.version);
+    queuedJob = job;
+    hasQueuedJob = true;
+    pthread_cond_signal(&queueCond);
+    pthread_mutex_unlock(&queueMutex);
+}
+
+const LineSet *AcquireFrontLines(bool *published) {
+    pthread_mutex_lock(&frontMutex);
+    *published = frontPublished;
+    frontPublished = false;
+    return frontLines;
+}
+
+void ReleaseFrontLines(void) {
+    pthread_mutex_unlock(&frontMutex);
+}
+#endif
@@ -0,0 +1,218 @@
+#ifndef FIELDLINES_H
+#define FIELDLINES_H
+
+#include "raylib.h"
+#include "field.h"
+#include "fieldtree.h"
+#include "fieldfmm.h"
+#include "fieldlattice.h"
+#include "fieldsinks.h"
+#include <stddef.h>
+
+// Native builds trace on a worker thread; the web build (which would need
+// SharedArrayBuffer for threads) time-slices the tracer on the main thread
+#if !defined(PLATFORM_WEB) && !defined(TRACE_SINGLE_THREADED)
+    #define TRACE_THREADED
+#endif
+
+#define MAX_CHARGES 262144
+#define FIELD_LINE_STEP_SIZE 0.05f         // first step of every line; later ones adapt
+#define FIELD_LINE_MIN_STEP 0.001f          // accepted whatever its error
+#define FIELD_LINE_MAX_STEP 2.0f
+#define FIELD_LINE_FAR_STEP_RATIO 0.5f   // ... or this times the distance from the charges, outside them
+#define FIELD_LINE_DEFAULT_TOLERANCE 1e-2f  // local position error allowed per step
+#define FIELD_LINE_FADE_LENGTH 2.5f         // arc length over which a line's tail fades out
+#define FIELD_LINE_JUMP_MAX_DEVIATION 0.1f  // field deviation from a lone charge's below which radial jumps are tried
+#define FIELD_LINE_JUMP_MIN_GAIN 2.0f       // ... and taken when this many Runge-Kutta steps long
+#define FIELD_LINE_DEFAULT_MIN_PER_SOURCE 4 // lines every positive charge gets, while the line budget allows
+#define FIELD_LINE_DEFAULT_BUDGET 4096
+#define PERTURBATION_SAMPLE_SPACING 0.25f  // arc length between the edit-perturbation samples of a kept line
+#define SCENE_CACHE_SLOTS 16
+#define TRACE_STEP_QUANTUM 256      // field evaluations between budget / cancellation checks
+#define TRACE_PACKETS 16            // packets of lines in progress; the tree and multipole
+                                    // evaluators run them on every core
+
+typedef struct FieldLineVertex {
+    Vector3 position;
+    Color color;
+} 
+FieldLineVertex;
+
+// Resolution a trace actually runs at (full quality, or the drag preview tier)
+typedef struct TraceQuality {
+    float linesPerCharge;       // lines per unit of positive charge, so line counts follow flux
+    int lineBudget;             // hard cap on the lines of all sources together
+    int minLinesPerSource;      // lines every source gets while the budget allows
+    float length;               // arc length a line may reach
+    float tolerance;            // local error allowed per integration step, in scene units
+    FieldPrecision precision;
+    float treeTheta;            // Barnes-Hut opening angle, 0 for the direct sum
+    int fmmOrder;               // fast multipole expansion order, 0 when off (overrides treeTheta)
+    int latticeResolution;      // nodes per side of the interpolated field lattice, 0 when off
+    bool preview;
+} 
+TraceQuality;
+
+// A traced (or pending) field line and its range in the owning LineSet
+typedef struct FieldLine {
+    Vector3 seed;
+    int source;         // index of the emitting charge
+    int firstVertex;
+    int vertexCount;
+    float drift;        // summed |dE|/|E| bound of the edits kept since it was traced
+    bool traced;
+} 
+FieldLine;
+
+// A single-charge edit; a zero value on either side means added / deleted
+typedef struct ChargeEdit {
+    int index;
+    Charge before;
+    Charge after;
+} 
+ChargeEdit;
+
+// How a trace shares its lines among the positive charges: linesPerCharge per
+// unit of charge, rounded, and at least minLinesPerSource. When that
+// would exceed lineBudget, each source keeps the minimum (less if even that does
+// not fit) plus its share, in proportion to charge, of the rest of the budget.
+typedef struct LineAllocation {
+    int minimum;                // lines every source gets
+    double perCharge;           // lines per unit of charge: the rounded count, or on top of minimum when capped
+    bool capped;                // the budget binds
+}
+LineAllocation;
+
+// Field lines plus the geometry they own (pairs of vertices, one pair per
+// segment) and the field magnitude at the start of each segment, used to
+// bound edit perturbations
+typedef struct LineSet {
+    FieldLine *lines;
+    int lineCount;
+    int lineCapacity;
+    FieldLineVertex *vertices;
+    float *segmentField;
+    int vertexCount;
+    int vertexCapacity;
+    unsigned int version;       // scene version of a complete trace, 0 while partial
+    TraceQuality quality;
+    LineAllocation allocation;  // how the lines were shared among the sources
+} 
+LineSet;
+
+// Snapshot of everything a trace reads, so it can run away from the UI state
+typedef struct TraceJob {
+    unsigned int version;
+    unsigned int chargeVersion; // bumped only by edits to the charges, 0 if unknown
+    Charge *charges;            // owned by the job
+    int numCharges;
+    TraceQuality quality;
+    bool hasEdit;               // edit turns version - 1 into version
+    ChargeEdit edit;
+    float retraceTolerance;     // summed relative |dE|/|E| above which a line is retraced
+    bool cacheable;             // worth keeping in the scene cache once finished
+} 
+TraceJob;
+
+// One lane of the packet tracer: a field line suspended at some stage of an
+// integration step (the stage's point is its head in the packet), with the
+// segments traced so far, which move into the target in one piece when the line
+// ends so its vertices stay contiguous
+typedef struct LineCursor {
+    int line;                   // index into the target's lines
+    int stage;                  // Runge-Kutta stage the head is at (0 at the base), or a radial jump
+    float length;               // arc length traced so far
+    float step;                 // size of the step in progress
+    Vector3 base;               // last accepted point, where the step starts
+    Vector3 tangents[3];        // unit field directions at the stages evaluated so far
+    Vector3 next;               // the step's third-order end point, once known, or the jump's end
+    Vector3 jumpCentre;         // radial jump in flight: the charge it follows,
+    float jumpCharge;
+    float jumpDeviation;        // and the relative field deviation it predicts at its end
+    float baseField;            // |E| and nearest squared source / sink distances at base
+    float baseSourceDistSq;
+    float baseSinkDistSq;
+    float sinkClearanceSq;      // heads nearer than this (squared) to base cannot be in a sink (negative: unknown)
+    FieldSinkCursor sinkCursor; // finds the nearest sink at each base
+    LineSet segments;
+} 
+LineCursor;
+
+// Progress of one job into its target LineSet
+typedef struct TraceState {
+    TraceJob job;
+    unsigned long long key;
+    LineSet *target;
+    int nextLine;               // scan cursor for untraced lines
+    LineCursor lanes[TRACE_PACKETS][FIELD_PACKET_LANES];  // lines in progress, packed at the front
+    FieldPacket packets[TRACE_PACKETS];  // their heads, packets[k].count of them
+    ChargeArrays sources;       // kernel layout of job.charges, kept across jobs
+    FieldTree tree;             // octree over job.charges when quality.treeTheta > 0
+    FieldFmm fmm;               // expansions of job.charges when quality.fmmOrder > 0
+    FieldLattice lattice;       // sampled field when quality.latticeResolution > 0
+    FieldSinkGrid sinks;        // negative charges of job.charges, for sink tests and colours
+    LineAllocation allocation;  // lines per source of job.charges
+    float netCharge;            // far field of job.charges: net charge, charge centroid
+    Vector3 centroid;           // (no dipole moment about it) and the largest charge
+    float clusterRadius;        // distance from it, for radial jumps
+    int pendingLines;           // lines (re)traced by this job
+    int finishedLines;
+    int firstChangedVertex;     // target vertices before this are unchanged since it was last complete
+    bool active;
+} 
+TraceState;
+
+typedef struct TraceStats {
+    int cacheHits;
+    int cacheMisses;
+    size_t cacheBytes;
+    int pendingLines;           // lines (re)traced by the trace in flight
+    int finishedLines;
+    bool preview;
+    int completedJobs;
+    int cancelledJobs;          // superseded before finishing (or before starting)
+} 
+TraceStats;
+
+Color CustomColorLerp(Color c1, Color c2, float amount);
+
+// Lines a trace of these charges at this quality seeds in total
+int CountFieldLines(const Charge *charges, int count, const TraceQuality *quality);
+
+void FreeTraceJob(TraceJob *job);
+void UnloadTraceState(TraceState *state);
+void UnloadLineSet(LineSet *set);
+
+// Starts tracing job into target: from the scene cache when the configuration
+// was traced before, selectively from base after a lone charge edit at the same
+// quality, otherwise from scratch. Takes ownership of job. base may be target.
+void BeginTrace(TraceState *state, TraceJob job, LineSet *target, const LineSet *base);
+
+// Advances the trace by about maxSteps field evaluations (whole rounds of packets,
+// so up to TRACE_PACKETS * FIELD_PACKET_LANES - 1 more), suspending lines mid-way
+// if need be; returns the evaluations made, fewer than maxSteps only once every
+// line is traced
+int AdvanceTrace(TraceState *state, int maxSteps);
+
+// Traces until budget seconds have passed; returns true once done. A job whose
+// version is no longer the newest begun or submitted generation is abandoned
+// within TRACE_STEP_QUANTUM evaluations, leaving target partial (version 0).
+bool ContinueTrace(TraceState *state, double budget);
+
+TraceStats GetTraceStats(void);
+void ClearSceneCache(void);
+
+#if defined(TRACE_THREADED)
+// Background tracer: the newest submitted job replaces any job still waiting,
+// and finished traces swap into the front set that the renderer reads
+void StartTraceWorker(void);
+void StopTraceWorker(void);
+void SubmitTraceJob(TraceJob job);
+
+// Locks the front set against swaps until ReleaseFrontLines(); published is
+// set when it changed since the previous call
+const LineSet *AcquireFrontLines(bool *published);
+void ReleaseFrontLines(void);
+#endif
+
+#endif // FIELDLINES_H
@@ -0,0 +1,207 @@
+#include "fieldsinks.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// A little over the sink radius, so rounding in the cell range never drops a sink
+// right at its edge
+#define SINK_REACH (1.01f * sqrtf(FIELD_SINK_RADIUS_SQ))
+
+void UnloadFieldSinkGrid(FieldSinkGrid *grid) {
+    free(grid->cellStart);
+    free(grid->x);
+    free(grid->y);
+    free(grid->z);
+    *grid = (FieldSinkGrid){ 0 };
+}
+
+// Smallest cell (at least two sink reaches) for which the grid over the given
+// extents stays within FIELD_SINK_GRID_CELLS_PER_SINK cells per sink
+static float ChooseCellSize(float extentX, float extentY, float extentZ, int sinks) {
+    double budget = (double)FIELD_SINK_GRID_CELLS_PER_SINK * sinks + 1.0;
+    float cell = fmaxf(2.0f * SINK_REACH, cbrtf((float)(extentX * extentY * extentZ / budget)));
+    while (((int)(extentX / cell) + 1.0) * ((int)(extentY / cell) + 1.0) * ((int)(extentZ / cell) + 1.0) > budget) cell *= 1.25f;
+    return cell;
+}
+
+static int CellIndex(float v, float min, float inverseCellSize, int cells) {
+    float f = (v - min) * inverseCellSize;
+    return f < 0.0f ? 0 : f >= cells ? cells - 1 : (int)f;
+}
+
+static int SinkCell(const FieldSinkGrid *grid, Vector3 p) {
+    int x = CellIndex(p.x, grid->minX, grid->inverseCellSize, grid->cellsX);
+    int y = CellIndex(p.y, grid->minY, grid->inverseCellSize, grid->cellsY);
+    int z = CellIndex(p.z, grid->minZ, grid->inverseCellSize, grid->cellsZ);
+    return (z * grid->cellsY + y) * grid->cellsX + x;
+}
+
+void SyncFieldSinkGrid(FieldSinkGrid *grid, const Charge *charges, int count, unsigned int chargeVersion) {
+    if (chargeVersion != 0 && grid->chargeVersion == chargeVersion) return;
+    UnloadFieldSinkGrid(grid);
+
+    int sinks = 0;
+    Vector3 lo = { INFINITY, INFINITY, INFINITY }, hi = { -INFINITY, -INFINITY, -INFINITY };
+    for (int k = 0; k < count; k++) {
+        if (charges[k].value > 0) continue;
+        Vector3 p = charges[k].position;
+        lo = (Vector3){ fminf(lo.x, p.x), fminf(lo.y, p.y), fminf(lo.z, p.z) };
+        hi = (Vector3){ fmaxf(hi.x, p.x), fmaxf(hi.y, p.y), fmaxf(hi.z, p.z) };
+        sinks++;
+    }
+    grid->chargeVersion = chargeVersion;
+    if (sinks == 0) return;
+
+    float cell = ChooseCellSize(hi.x - lo.x, hi.y - lo.y, hi.z - lo.z, sinks);
+    int cellsX = (int)((hi.x - lo.x) / cell) + 1, cellsY = (int)((hi.y - lo.y) / cell) + 1, cellsZ = (int)((hi.z - lo.z) / cell) + 1;
+    int cells = cellsX * cellsY * cellsZ;
+    grid->cellStart = calloc(cells + 1, sizeof(int));
+    grid->x = malloc(sinks * sizeof(float));
+    grid->y = malloc(sinks * sizeof(float));
+    grid->z = malloc(sinks * sizeof(float));
+    int *next = malloc(cells * sizeof(int));
+    if (!grid->cellStart || !grid->x || !grid->y || !grid->z || !next) {
+        free(next);
+        UnloadFieldSinkGrid(grid);
+        return;
+    }
+
+    grid->minX = lo.x;
+    grid->minY = lo.y;
+    grid->minZ = lo.z;
+    grid->cellSize = cell;
+    grid->inverseCellSize = 1.0f / cell;
+    grid->cellsX = cellsX;
+    grid->cellsY = cellsY;
+    grid->cellsZ = cellsZ;
+
+    for (int k = 0; k < count; k++)
+        if (charges[k].value <= 0) grid->cellStart[SinkCell(grid, charges[k].position) + 1]++;
+    for (int c = 0; c < cells; c++) grid->cellStart[c + 1] += grid->cellStart[c];
+
+    for (int c = 0; c < cells; c++) next[c] = grid->cellStart[c];
+    for (int k = 0; k < count; k++) {
+        if (charges[k].value > 0) continue;
+        int i = next[SinkCell(grid, charges[k].position)]++;
+        grid->x[i] = charges[k].position.x;
+        grid->y[i] = charges[k].position.y;
+        grid->z[i] = charges[k].position.z;
+    }
+    free(next);
+    grid->count = sinks;
+}
+
+bool IsInFieldSink(const FieldSinkGrid *grid, Vector3 p) {
+    if (grid->count == 0) return false;
+
+    float point[3] = { p.x, p.y, p.z }, min[3] = { grid->minX, grid->minY, grid->minZ };
+    int cells[3] = { grid->cellsX, grid->cellsY, grid->cellsZ }, lo[3], hi[3];
+    for (int axis = 0; axis < 3; axis++) {
+        float low = (point[axis] - SINK_REACH - min[axis]) * grid->inverseCellSize;
+        float high = (point[axis] + SINK_REACH - min[axis]) * grid->inverseCellSize;
+        if (!(high >= 0.0f && low < cells[axis])) return false;
+        lo[axis] = low < 0.0f ? 0 : (int)low;
+        hi[axis] = high >= cells[axis] ? cells[axis] - 1 : (int)high;
+    }
+
+    for (int z = lo[2]; z <= hi[2]; z++)
+        for (int y = lo[1]; y <= hi[1]; y++) {
+            int row = (z * grid->cellsY + y) * grid->cellsX;
+            for (int k = grid->cellStart[row + lo[0]]; k < grid->cellStart[row + hi[0] + 1]; k++) {
+                float rx = p.x - grid->x[k];
+                float ry = p.y - grid->y[k];
+                float rz = p.z - grid->z[k];
+                if (rx*rx + ry*ry + rz*rz < FIELD_SINK_RADIUS_SQ) return true;
+            }
+        }
+    return false;
+}
+
+// Nearest and second-nearest squared distances from p to the sinks seen so far
+typedef struct NearestSinks {
+    float bestSq;
+    float secondSq;
+    int best;                   // index of the nearest, -1 if none
+}
+NearestSinks;
+
+static void ScanCells(const FieldSinkGrid *grid, int first, int last, Vector3 p, NearestSinks *found) {
+    for (int k = grid->cellStart[first]; k < grid->cellStart[last + 1]; k++) {
+        float rx = p.x - grid->x[k];
+        float ry = p.y - grid->y[k];
+        float rz = p.z - grid->z[k];
+        float r2 = rx*rx + ry*ry + rz*rz;
+        if (r2 < found->bestSq) {
+            found->secondSq = found->bestSq;
+            found->bestSq = r2;
+            found->best = k;
+        }
+        else if (r2 < found->secondSq) found->secondSq = r2;
+    }
+}
+
+// Searches the grid until no unseen sink can be nearer than the nearest (or,
+// with second, the second nearest) found
+static NearestSinks SearchNearestSinks(const FieldSinkGrid *grid, Vector3 p, bool second) {
+    NearestSinks found = { 1.0e8f, 1.0e8f, -1 };
+    if (grid->count == 0) return found;
+
+    // Clamping p onto the grid gives q; along each axis a sink is then no nearer
+    // to p than to q plus the clamped-off part, so the squares of the two add up
+    float point[3] = { p.x, p.y, p.z }, min[3] = { grid->minX, grid->minY, grid->minZ };
+    int cells[3] = { grid->cellsX, grid->cellsY, grid->cellsZ }, home[3], shells = 0;
+    float outsideSq = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float q = fminf(fmaxf(point[axis], min[axis]), min[axis] + cells[axis] * grid->cellSize);
+        outsideSq += (point[axis] - q) * (point[axis] - q);
+        home[axis] = CellIndex(q, min[axis], grid->inverseCellSize, cells[axis]);
+        int reach = home[axis] > cells[axis] - 1 - home[axis] ? home[axis] : cells[axis] - 1 - home[axis];
+        shells = reach > shells ? reach : shells;
+    }
+
+    // Shell s holds the cells s steps from q's (Chebyshev), at least (s - 1) cells from q
+    for (int s = 0; s <= shells; s++) {
+        float gap = (s - 1) * grid->cellSize;
+        if (s > 0 && outsideSq + gap * gap >= (second ? found.secondSq : found.bestSq)) break;
+
+        int lo[3], hi[3];
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = home[axis] - s < 0 ? 0 : home[axis] - s;
+            hi[axis] = home[axis] + s >= cells[axis] ? cells[axis] - 1 : home[axis] + s;
+        }
+        for (int z = lo[2]; z <= hi[2]; z++)
+            for (int y = lo[1]; y <= hi[1]; y++) {
+                int row = (z * cells[1] + y) * cells[0];
+                if (abs(z - home[2]) == s || abs(y - home[1]) == s) ScanCells(grid, row + lo[0], row + hi[0], p, &found);
+                else {
+                    if (home[0] - s >= 0) ScanCells(grid, row + home[0] - s, row + home[0] - s, p, &found);
+                    if (home[0] + s < cells[0]) ScanCells(grid, row + home[0] + s, row + home[0] + s, p, &found);
+                }
+            }
+    }
+    return found;
+}
+
+float NearestFieldSinkDistSq(const FieldSinkGrid *grid, Vector3 p) {
+    return SearchNearestSinks(grid, p, false).bestSq;
+}
+
+float TrackNearestFieldSinkDistSq(const FieldSinkGrid *grid, FieldSinkCursor *cursor, Vector3 p) {
+    // The remembered sink is still the nearest while it is no farther than the
+    // others can have come since the search
+    if (cursor->nearest >= 0) {
+        float rx = p.x - grid->x[cursor->nearest];
+        float ry = p.y - grid->y[cursor->nearest];
+        float rz = p.z - grid->z[cursor->nearest];
+        float r2 = rx*rx + ry*ry + rz*rz;
+        float mx = p.x - cursor->origin.x, my = p.y - cursor->origin.y, mz = p.z - cursor->origin.z;
+        float othersDist = cursor->othersDist - sqrtf(mx*mx + my*my + mz*mz);
+        if (othersDist > 0.0f && r2 <= othersDist * othersDist) return r2;
+    }
+
+    NearestSinks found = SearchNearestSinks(grid, p, true);
+    cursor->origin = p;
+    cursor->nearest = found.best;
+    cursor->othersDist = 0.999f * sqrtf(found.secondSq);
+    return found.bestSq;
+}
@@ -0,0 +1,56 @@
+#ifndef FIELDSINKS_H
+#define FIELDSINKS_H
+
+#include "field.h"
+
+// Uniform grid over the negative charges, for the tracer's sink tests: the field
+// kernels no longer track the nearest sink in their charge loops. Cells are at
+// least twice the sink radius wide, so a capture test reads at most 8 of them;
+// beyond that they grow with the sinks' spread, to about
+// FIELD_SINK_GRID_CELLS_PER_SINK cells per sink over the sinks' bounds. A few
+// sinks per cell keeps small scenes at a scan or two of short lists.
+#define FIELD_SINK_GRID_CELLS_PER_SINK 0.25
+
+typedef struct FieldSinkGrid {
+    float minX, minY, minZ;     // low corner: the sinks' bounds
+    float cellSize;
+    float inverseCellSize;
+    int cellsX, cellsY, cellsZ;
+    int *cellStart;             // cell c holds sinks [cellStart[c], cellStart[c + 1]), x fastest
+    float *x;                   // sinks grouped by cell
+    float *y;
+    float *z;
+    int count;
+    unsigned int chargeVersion; // charge edit the grid was built from, 0 if unknown
+}
+FieldSinkGrid;
+
+// Rebuilds the grid unless it already holds chargeVersion (0 always rebuilds).
+// Charges that are not positive are sinks, as in the field kernels. If memory
+// runs out the grid is left empty.
+void SyncFieldSinkGrid(FieldSinkGrid *grid, const Charge *charges, int count, unsigned int chargeVersion);
+void UnloadFieldSinkGrid(FieldSinkGrid *grid);
+
+// Whether p is within the sink radius of a negative charge; squared distances are
+// computed as the kernels compute them, so the answer is theirs
+bool IsInFieldSink(const FieldSinkGrid *grid, Vector3 p);
+
+// Squared distance from p to the nearest negative charge, 1e8 if none. Cells are
+// visited in shells around p's, nearest first, until no nearer sink can remain.
+float NearestFieldSinkDistSq(const FieldSinkGrid *grid, Vector3 p);
+
+// Nearest-sink search for a point that moves in small steps (a line's vertices).
+// It remembers the sink found nearest and a lower bound on the distance to every
+// other; until the point has moved far enough for another to overtake it, the
+// answer costs one distance. Start with nearest -1.
+typedef struct FieldSinkCursor {
+    Vector3 origin;             // where the grid was last searched
+    int nearest;                // sink found nearest there, -1 before any search
+    float othersDist;           // lower bound on the distance from origin to any other sink
+}
+FieldSinkCursor;
+
+// Same result as NearestFieldSinkDistSq for the grid the cursor was used with
+float TrackNearestFieldSinkDistSq(const FieldSinkGrid *grid, FieldSinkCursor *cursor, Vector3 p);
+
+#endif // FIELDSINKS_H
@@ -0,0 +1,125 @@
+#include "fieldtask.h"
+
+#if !defined(PLATFORM_WEB) && !defined(TRACE_SINGLE_THREADED)
+    #define FIELD_TASK_THREADED
+    #include <pthread.h>
+    #include <stdatomic.h>
+    #include <unistd.h>
+#endif
+
+#if defined(FIELD_TASK_THREADED)
+typedef struct FieldTaskRun {
+    FieldTask task;
+    void *data;
+    const void *context;
+    int count;
+    int chunk;                  // indices claimed at a time
+    int helpers;                // pool workers joining the caller
+    atomic_int next;
+}
+FieldTaskRun;
+
+// Workers started on first use and kept for the life of the process, so the
+// tracer's per-round calls only wake them instead of creating threads
+typedef struct FieldTaskPool {
+    pthread_mutex_t busy;       // held by the caller whose run owns the workers
+    pthread_mutex_t lock;       // guards the fields below
+    pthread_cond_t start;       // signalled when a new run is posted
+    pthread_cond_t done;        // signalled when the last helper finishes
+    FieldTaskRun *run;
+    unsigned int generation;    // bumped for every posted run
+    int active;                 // helpers still working on the run
+    int workers;
+}
+FieldTaskPool;
+
+static FieldTaskPool pool = {
+    .busy = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER
+};
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+
+static void ClaimChunks(FieldTaskRun *run) {
+    for (;;) {
+        int first = atomic_fetch_add(&run->next, run->chunk);
+        if (first >= run->count) return;
+        int end = first + run->chunk < run->count ? first + run->chunk : run->count;
+        for (int i = first; i < end; i++) run->task(run->data, run->context, i);
+    }
+}
+
+static void *FieldTaskWorker(void *arg) {
+    int id = (int)(long)arg;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.generation == seen) pthread_cond_wait(&pool.start, &pool.lock);
+        seen = pool.generation;
+        FieldTaskRun *run = pool.run;
+        if (id >= run->helpers) continue;
+
+        pthread_mutex_unlock(&pool.lock);
+        ClaimChunks(run);
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.active == 0) pthread_cond_signal(&pool.done);
+    }
+    return NULL;
+}
+
+static void StartFieldTaskPool(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cores < 1 ? 1 : cores > FIELD_TASK_MAX_THREADS ? FIELD_TASK_MAX_THREADS : (int)cores;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int t = 1; t < threads; t++) {
+        pthread_t worker;
+        if (pthread_create(&worker, &attr, FieldTaskWorker, (void *)(long)pool.workers) == 0) pool.workers++;
+    }
+    pthread_attr_destroy(&attr);
+}
+#endif
+
+static void RunChunks(FieldTask task, void *data, const void *context, int count, int chunk) {
+#if defined(FIELD_TASK_THREADED)
+    pthread_once(&poolOnce, StartFieldTaskPool);
+    int chunks = (count + chunk - 1) / chunk;
+    int helpers = pool.workers < chunks - 1 ? pool.workers : chunks - 1;
+
+    // A run posted while another holds the pool (or from inside a task) goes inline
+    if (helpers > 0 && pthread_mutex_trylock(&pool.busy) == 0) {
+        FieldTaskRun run = { .task = task, .data = data, .context = context, .count = count, .chunk = chunk, .helpers = helpers };
+        atomic_init(&run.next, 0);
+
+        pthread_mutex_lock(&pool.lock);
+        pool.run = &run;
+        pool.active = helpers;
+        pool.generation++;
+        pthread_cond_broadcast(&pool.start);
+        pthread_mutex_unlock(&pool.lock);
+
+        ClaimChunks(&run);
+
+        pthread_mutex_lock(&pool.lock);
+        while (pool.active > 0) pthread_cond_wait(&pool.done, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+        pthread_mutex_unlock(&pool.busy);
+        return;
+    }
+#else
+    (void)chunk;
+#endif
+    for (int i = 0; i < count; i++) task(data, context, i);
+}
+
+void RunFieldTask(FieldTask task, void *data, const void *context, int count) {
+    RunChunks(task, data, context, count, FIELD_TASK_CHUNK);
+}
+
+void RunFieldTaskEach(FieldTask task, void *data, const void *context, int count) {
+    RunChunks(task, data, context, count, 1);
+}
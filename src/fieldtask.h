@@ -0,0 +1,22 @@
+#ifndef FIELDTASK_H
+#define FIELDTASK_H
+
+// Parallel loop for the precomputation passes (multipole expansions, the field
+// lattice) and the tracer's packets. Native builds spread it over every core
+// through a pool of workers started on first use; the web build (no threads
+// without SharedArrayBuffer) and TRACE_SINGLE_THREADED builds run it inline.
+#define FIELD_TASK_MAX_THREADS 64
+#define FIELD_TASK_CHUNK 16         // indices a thread claims at a time
+
+// Called once per index with the data and context given to RunFieldTask; calls
+// may run concurrently, so a task writes only the data its index owns
+typedef void (*FieldTask)(void *data, const void *context, int index);
+
+// Runs task for every index in [0, count) and returns when all are done
+void RunFieldTask(FieldTask task, void *data, const void *context, int count);
+
+// The same for a few costly indices (the tracer's packets): threads claim one
+// index at a time, so even count 2 is split
+void RunFieldTaskEach(FieldTask task, void *data, const void *context, int count);
+
+#endif // FIELDTASK_H
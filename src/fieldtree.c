@@ -0,0 +1,516 @@
+#include "fieldtree.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// The lane loops are written for 4-wide vectors: SSE2 wherever the compiler
+// targets it (every x86-64 build), SIMD128 in the -msimd128 web build, scalar
+// otherwise. Tree work is mostly traversal, so wider ISAs are not dispatched.
+#if defined(__SSE2__) && !defined(PLATFORM_WEB)
+    #define FIELD_TREE_SSE2
+    #include <emmintrin.h>
+#elif defined(__wasm_simd128__)
+    #define FIELD_TREE_SIMD128
+    #include <wasm_simd128.h>
+#endif
+
+#define FIELD_TREE_GROUP 4
+
+// Deep enough for FIELD_TREE_MAX_DEPTH levels of up to eight pending siblings
+#define FIELD_TREE_STACK_SIZE (FIELD_TREE_MAX_DEPTH * 7 + 8)
+
+void UnloadFieldTree(FieldTree *tree) {
+    free(tree->nodes);
+    free(tree->x);
+    free(tree->y);
+    free(tree->z);
+    free(tree->q);
+    *tree = (FieldTree){ .leafSize = tree->leafSize };
+}
+
+static void SwapCharges(FieldTree *tree, int a, int b) {
+    float t;
+    t = tree->x[a]; tree->x[a] = tree->x[b]; tree->x[b] = t;
+    t = tree->y[a]; tree->y[a] = tree->y[b]; tree->y[b] = t;
+    t = tree->z[a]; tree->z[a] = tree->z[b]; tree->z[b] = t;
+    t = tree->q[a]; tree->q[a] = tree->q[b]; tree->q[b] = t;
+}
+
+// Moves charges in [first, end) with coordinate below split to the front and
+// returns where the rest begin
+static int PartitionCharges(FieldTree *tree, const float *axis, int first, int end, float split) {
+    int i = first, j = end - 1;
+    while (i <= j) {
+        if (axis[i] < split) i++;
+        else SwapCharges(tree, i, j--);
+    }
+    return i;
+}
+
+// Moves a leaf's positive charges to its front and returns where the rest begin
+static int PartitionSources(FieldTree *tree, int first, int end) {
+    int i = first, j = end - 1;
+    while (i <= j) {
+        if (tree->q[i] > 0) i++;
+        else SwapCharges(tree, i, j--);
+    }
+    return i;
+}
+
+// Returns the index of a fresh node, or -1 if the node array cannot grow.
+// May move tree->nodes, so callers hold nodes by index across it.
+static int ReserveNodes(FieldTree *tree, int count) {
+    if (tree->nodeCount + count > tree->nodeCapacity) {
+        int capacity = tree->nodeCapacity ? tree->nodeCapacity * 2 : 64;
+        while (capacity < tree->nodeCount + count) capacity *= 2;
+        FieldTreeNode *nodes = realloc(tree->nodes, capacity * sizeof(FieldTreeNode));
+        if (!nodes) return -1;
+        tree->nodes = nodes;
+        tree->nodeCapacity = capacity;
+    }
+
+    int first = tree->nodeCount;
+    tree->nodeCount += count;
+    return first;
+}
+
+// Bounds and moments of the node's charge range
+static void ComputeNodeMoments(FieldTree *tree, FieldTreeNode *node) {
+    int end = node->first + node->count;
+
+    float weight = 0.0f, q = 0.0f;
+    float wx = 0.0f, wy = 0.0f, wz = 0.0f;
+    node->minX = node->minY = node->minZ = INFINITY;
+    node->maxX = node->maxY = node->maxZ = -INFINITY;
+    node->hasSources = false;
+
+    for (int k = node->first; k < end; k++) {
+        float x = tree->x[k], y = tree->y[k], z = tree->z[k], w = fabsf(tree->q[k]);
+        node->minX = fminf(node->minX, x); node->maxX = fmaxf(node->maxX, x);
+        node->minY = fminf(node->minY, y); node->maxY = fmaxf(node->maxY, y);
+        node->minZ = fminf(node->minZ, z); node->maxZ = fmaxf(node->maxZ, z);
+        if (tree->q[k] > 0) node->hasSources = true;
+
+        weight += w;
+        q += tree->q[k];
+        wx += w * x;
+        wy += w * y;
+        wz += w * z;
+    }
+
+    // The |q|-weighted centroid zeroes the dipole of single-sign cells; cells of
+    // zero charges fall back to the middle of their bounds
+    if (weight > 0.0f) {
+        node->cx = wx / weight;
+        node->cy = wy / weight;
+        node->cz = wz / weight;
+    } else {
+        node->cx = 0.5f * (node->minX + node->maxX);
+        node->cy = 0.5f * (node->minY + node->maxY);
+        node->cz = 0.5f * (node->minZ + node->maxZ);
+    }
+
+    node->q = q;
+    node->px = node->py = node->pz = 0.0f;
+    for (int k = node->first; k < end; k++) {
+        node->px += tree->q[k] * (tree->x[k] - node->cx);
+        node->py += tree->q[k] * (tree->y[k] - node->cy);
+        node->pz += tree->q[k] * (tree->z[k] - node->cz);
+    }
+
+    float size = fmaxf(node->maxX - node->minX, fmaxf(node->maxY - node->minY, node->maxZ - node->minZ));
+    node->sizeSq = size * size;
+}
+
+static bool BuildNode(FieldTree *tree, int index, int depth) {
+    FieldTreeNode *node = &tree->nodes[index];
+    ComputeNodeMoments(tree, node);
+    node->child = -1;
+    node->childCount = 0;
+    int leafSize = tree->leafSize > 0 ? tree->leafSize : FIELD_TREE_LEAF_SIZE;
+    if (node->count <= leafSize || depth >= FIELD_TREE_MAX_DEPTH || node->sizeSq == 0.0f) {
+        node->sourceCount = PartitionSources(tree, node->first, node->first + node->count) - node->first;
+        return true;
+    }
+
+    // Split the bounds at their middle into octants: by x, then each half by y,
+    // then each quarter by z. Bounds 0 and 8 frame the eight ranges.
+    float midX = 0.5f * (node->minX + node->maxX);
+    float midY = 0.5f * (node->minY + node->maxY);
+    float midZ = 0.5f * (node->minZ + node->maxZ);
+    int bounds[9];
+    bounds[0] = node->first;
+    bounds[8] = node->first + node->count;
+    bounds[4] = PartitionCharges(tree, tree->x, bounds[0], bounds[8], midX);
+    bounds[2] = PartitionCharges(tree, tree->y, bounds[0], bounds[4], midY);
+    bounds[6] = PartitionCharges(tree, tree->y, bounds[4], bounds[8], midY);
+    for (int i = 1; i < 8; i += 2) bounds[i] = PartitionCharges(tree, tree->z, bounds[i - 1], bounds[i + 1], midZ);
+
+    int childCount = 0;
+    for (int i = 0; i < 8; i++)
+        if (bounds[i + 1] > bounds[i]) childCount++;
+
+    // Children sit next to each other so a node only stores the first
+    int child = ReserveNodes(tree, childCount);
+    if (child < 0) return false;
+    tree->nodes[index].child = child;
+    tree->nodes[index].childCount = childCount;
+
+    for (int i = 0, c = child; i < 8; i++) {
+        if (bounds[i + 1] == bounds[i]) continue;
+        tree->nodes[c] = (FieldTreeNode){ .first = bounds[i], .count = bounds[i + 1] - bounds[i] };
+        if (!BuildNode(tree, c++, depth + 1)) return false;
+    }
+
+    return true;
+}
+
+void SyncFieldTree(FieldTree *tree, const Charge *charges, int count, unsigned int chargeVersion) {
+    if (chargeVersion != 0 && tree->chargeVersion == chargeVersion) return;
+
+    if (count > tree->capacity) {
+        UnloadFieldTree(tree);
+        tree->x = malloc(count * sizeof(float));
+        tree->y = malloc(count * sizeof(float));
+        tree->z = malloc(count * sizeof(float));
+        tree->q = malloc(count * sizeof(float));
+        if (!tree->x || !tree->y || !tree->z || !tree->q) {
+            UnloadFieldTree(tree);
+            return;
+        }
+        tree->capacity = count;
+    }
+
+    for (int k = 0; k < count; k++) {
+        tree->x[k] = charges[k].position.x;
+        tree->y[k] = charges[k].position.y;
+        tree->z[k] = charges[k].position.z;
+        tree->q[k] = charges[k].value;
+    }
+
+    tree->count = count;
+    tree->nodeCount = 0;
+    tree->chargeVersion = 0;
+    if (count == 0) {
+        tree->chargeVersion = chargeVersion;
+        return;
+    }
+
+    int root = ReserveNodes(tree, 1);
+    if (root < 0) return;
+    tree->nodes[root] = (FieldTreeNode){ .first = 0, .count = count };
+    if (!BuildNode(tree, root, 0)) {
+        tree->nodeCount = 0;
+        return;
+    }
+
+    tree->chargeVersion = chargeVersion;
+}
+
+// Each helper handles the FIELD_TREE_GROUP lanes from first on, of which those
+// in the live bit mask take part, adding to the lanes' running results. AccumulateCell sums the cell for the lanes it
+// is far enough from and returns the mask of lanes that must open it instead.
+#if defined(FIELD_TREE_SSE2)
+static __m128 LaneMaskSSE2(unsigned int live) {
+    __m128i bits = _mm_setr_epi32(1, 2, 4, 8);
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)live), bits), bits));
+}
+
+// Where mask is set, b; elsewhere a
+static __m128 SelectSSE2(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+static unsigned int AccumulateCell(const FieldTreeNode *node, FieldPacket *lanes, int first, unsigned int live, float thetaSq) {
+    __m128 x = _mm_loadu_ps(lanes->x + first), y = _mm_loadu_ps(lanes->y + first), z = _mm_loadu_ps(lanes->z + first);
+    __m128 rx = _mm_sub_ps(x, _mm_set1_ps(node->cx));
+    __m128 ry = _mm_sub_ps(y, _mm_set1_ps(node->cy));
+    __m128 rz = _mm_sub_ps(z, _mm_set1_ps(node->cz));
+    __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz));
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 bx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(node->minX), x), _mm_sub_ps(x, _mm_set1_ps(node->maxX))), zero);
+    __m128 by = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(node->minY), y), _mm_sub_ps(y, _mm_set1_ps(node->maxY))), zero);
+    __m128 bz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(node->minZ), z), _mm_sub_ps(z, _mm_set1_ps(node->maxZ))), zero);
+    __m128 boundsSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, bx), _mm_mul_ps(by, by)), _mm_mul_ps(bz, bz));
+
+    __m128 liveMask = LaneMaskSSE2(live);
+    __m128 far = _mm_and_ps(liveMask, _mm_and_ps(_mm_cmplt_ps(_mm_set1_ps(node->sizeSq), _mm_mul_ps(_mm_set1_ps(thetaSq), r2)),
+                                                 _mm_cmpge_ps(boundsSq, _mm_set1_ps(FIELD_SINK_RADIUS_SQ))));
+    unsigned int open = live & ~(unsigned int)_mm_movemask_ps(far);
+    if (_mm_movemask_ps(far) == 0) return open;
+
+    // Monopole plus dipole about the centre
+    __m128 rInv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(r2));
+    __m128 r3Inv = _mm_mul_ps(_mm_mul_ps(rInv, rInv), rInv);
+    __m128 px = _mm_set1_ps(node->px), py = _mm_set1_ps(node->py), pz = _mm_set1_ps(node->pz), q = _mm_set1_ps(node->q);
+    __m128 pr = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(3.0f), _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, rx), _mm_mul_ps(py, ry)), _mm_mul_ps(pz, rz))), 
+                           _mm_mul_ps(rInv, rInv));
+    __m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(q, rx), _mm_mul_ps(pr, rx)), px), r3Inv);
+    __m128 dy = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(q, ry), _mm_mul_ps(pr, ry)), py), r3Inv);
+    __m128 dz = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(q, rz), _mm_mul_ps(pr, rz)), pz), r3Inv);
+    _mm_storeu_ps(lanes->ex + first, _mm_add_ps(_mm_loadu_ps(lanes->ex + first), _mm_and_ps(far, dx)));
+    _mm_storeu_ps(lanes->ey + first, _mm_add_ps(_mm_loadu_ps(lanes->ey + first), _mm_and_ps(far, dy)));
+    _mm_storeu_ps(lanes->ez + first, _mm_add_ps(_mm_loadu_ps(lanes->ez + first), _mm_and_ps(far, dz)));
+
+    __m128 nearSq = SelectSSE2(far, _mm_set1_ps(INFINITY), boundsSq);
+    if (node->hasSources) _mm_storeu_ps(lanes->minSourceDistSq + first, _mm_min_ps(_mm_loadu_ps(lanes->minSourceDistSq + first), nearSq));
+    return open;
+}
+
+static void AccumulateLeaf(const FieldTree *tree, const FieldTreeNode *node, FieldPacket *lanes, int first, unsigned int live) {
+    __m128 x = _mm_loadu_ps(lanes->x + first), y = _mm_loadu_ps(lanes->y + first), z = _mm_loadu_ps(lanes->z + first);
+    __m128 dx = _mm_setzero_ps(), dy = _mm_setzero_ps(), dz = _mm_setzero_ps();
+    __m128 minSourceSq = _mm_set1_ps(INFINITY);
+    int sourceEnd = node->first + node->sourceCount, end = node->first + node->count;
+
+    for (int k = node->first; k < end; k++) {
+        __m128 rx = _mm_sub_ps(x, _mm_set1_ps(tree->x[k]));
+        __m128 ry = _mm_sub_ps(y, _mm_set1_ps(tree->y[k]));
+        __m128 rz = _mm_sub_ps(z, _mm_set1_ps(tree->z[k]));
+        __m128 r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz));
+        __m128 rInv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(r2));
+        if (k < sourceEnd) minSourceSq = _mm_min_ps(minSourceSq, r2);
+
+        __m128 s = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(tree->q[k]), rInv), rInv), rInv);
+        dx = _mm_add_ps(dx, _mm_mul_ps(s, rx));
+        dy = _mm_add_ps(dy, _mm_mul_ps(s, ry));
+        dz = _mm_add_ps(dz, _mm_mul_ps(s, rz));
+    }
+
+    __m128 liveMask = LaneMaskSSE2(live);
+    _mm_storeu_ps(lanes->ex + first, _mm_add_ps(_mm_loadu_ps(lanes->ex + first), _mm_and_ps(liveMask, dx)));
+    _mm_storeu_ps(lanes->ey + first, _mm_add_ps(_mm_loadu_ps(lanes->ey + first), _mm_and_ps(liveMask, dy)));
+    _mm_storeu_ps(lanes->ez + first, _mm_add_ps(_mm_loadu_ps(lanes->ez + first), _mm_and_ps(liveMask, dz)));
+    __m128 oldSourceSq = _mm_loadu_ps(lanes->minSourceDistSq + first);
+    _mm_storeu_ps(lanes->minSourceDistSq + first, SelectSSE2(liveMask, oldSourceSq, _mm_min_ps(oldSourceSq, minSourceSq)));
+}
+
+#elif defined(FIELD_TREE_SIMD128)
+static v128_t LaneMaskSIMD128(unsigned int live) {
+    v128_t bits = wasm_i32x4_make(1, 2, 4, 8);
+    return wasm_i32x4_eq(wasm_v128_and(wasm_i32x4_splat((int)live), bits), bits);
+}
+
+static unsigned int AccumulateCell(const FieldTreeNode *node, FieldPacket *lanes, int first, unsigned int live, float thetaSq) {
+    v128_t x = wasm_v128_load(lanes->x + first), y = wasm_v128_load(lanes->y + first), z = wasm_v128_load(lanes->z + first);
+    v128_t rx = wasm_f32x4_sub(x, wasm_f32x4_splat(node->cx));
+    v128_t ry = wasm_f32x4_sub(y, wasm_f32x4_splat(node->cy));
+    v128_t rz = wasm_f32x4_sub(z, wasm_f32x4_splat(node->cz));
+    v128_t r2 = wasm_f32x4_add(wasm_f32x4_add(wasm_f32x4_mul(rx, rx), wasm_f32x4_mul(ry, ry)), wasm_f32x4_mul(rz, rz));
+
+    v128_t zero = wasm_f32x4_splat(0.0f);
+    v128_t bx = wasm_f32x4_pmax(wasm_f32x4_pmax(wasm_f32x4_sub(wasm_f32x4_splat(node->minX), x), wasm_f32x4_sub(x, wasm_f32x4_splat(node->maxX))), zero);
+    v128_t by = wasm_f32x4_pmax(wasm_f32x4_pmax(wasm_f32x4_sub(wasm_f32x4_splat(node->minY), y), wasm_f32x4_sub(y, wasm_f32x4_splat(node->maxY))), zero);
+    v128_t bz = wasm_f32x4_pmax(wasm_f32x4_pmax(wasm_f32x4_sub(wasm_f32x4_splat(node->minZ), z), wasm_f32x4_sub(z, wasm_f32x4_splat(node->maxZ))), zero);
+    v128_t boundsSq = wasm_f32x4_add(wasm_f32x4_add(wasm_f32x4_mul(bx, bx), wasm_f32x4_mul(by, by)), wasm_f32x4_mul(bz, bz));
+
+    v128_t far = wasm_v128_and(LaneMaskSIMD128(live), 
+                               wasm_v128_and(wasm_f32x4_lt(wasm_f32x4_splat(node->sizeSq), wasm_f32x4_mul(wasm_f32x4_splat(thetaSq), r2)),
+                                             wasm_f32x4_ge(boundsSq, wasm_f32x4_splat(FIELD_SINK_RADIUS_SQ))));
+    unsigned int open = live & ~(unsigned int)wasm_i32x4_bitmask(far);
+    if (!wasm_v128_any_true(far)) return open;
+
+    // Monopole plus dipole about the centre
+    v128_t rInv = wasm_f32x4_div(wasm_f32x4_splat(1.0f), wasm_f32x4_sqrt(r2));
+    v128_t r3Inv = wasm_f32x4_mul(wasm_f32x4_mul(rInv, rInv), rInv);
+    v128_t px = wasm_f32x4_splat(node->px), py = wasm_f32x4_splat(node->py), pz = wasm_f32x4_splat(node->pz), q = wasm_f32x4_splat(node->q);
+    v128_t pr = wasm_f32x4_mul(wasm_f32x4_mul(wasm_f32x4_splat(3.0f), wasm_f32x4_add(wasm_f32x4_add(wasm_f32x4_mul(px, rx), wasm_f32x4_mul(py, ry)), 
+                                                                                       wasm_f32x4_mul(pz, rz))), 
+                               wasm_f32x4_mul(rInv, rInv));
+    v128_t dx = wasm_f32x4_mul(wasm_f32x4_sub(wasm_f32x4_add(wasm_f32x4_mul(q, rx), wasm_f32x4_mul(pr, rx)), px), r3Inv);
+    v128_t dy = wasm_f32x4_mul(wasm_f32x4_sub(wasm_f32x4_add(wasm_f32x4_mul(q, ry), wasm_f32x4_mul(pr, ry)), py), r3Inv);
+    v128_t dz = wasm_f32x4_mul(wasm_f32x4_sub(wasm_f32x4_add(wasm_f32x4_mul(q, rz), wasm_f32x4_mul(pr, rz)), pz), r3Inv);
+    wasm_v128_store(lanes->ex + first, wasm_f32x4_add(wasm_v128_load(lanes->ex + first), wasm_v128_and(far, dx)));
+    wasm_v128_store(lanes->ey + first, wasm_f32x4_add(wasm_v128_load(lanes->ey + first), wasm_v128_and(far, dy)));
+    wasm_v128_store(lanes->ez + first, wasm_f32x4_add(wasm_v128_load(lanes->ez + first), wasm_v128_and(far, dz)));
+
+    v128_t nearSq = wasm_v128_bitselect(boundsSq, wasm_f32x4_splat(INFINITY), far);
+    if (node->hasSources) wasm_v128_store(lanes->minSourceDistSq + first, wasm_f32x4_pmin(wasm_v128_load(lanes->minSourceDistSq + first), nearSq));
+    return open;
+}
+
+static void AccumulateLeaf(const FieldTree *tree, const FieldTreeNode *node, FieldPacket *lanes, int first, unsigned int live) {
+    v128_t x = wasm_v128_load(lanes->x + first), y = wasm_v128_load(lanes->y + first), z = wasm_v128_load(lanes->z + first);
+    v128_t dx = wasm_f32x4_splat(0.0f), dy = wasm_f32x4_splat(0.0f), dz = wasm_f32x4_splat(0.0f);
+    v128_t minSourceSq = wasm_f32x4_splat(INFINITY);
+    int sourceEnd = node->first + node->sourceCount, end = node->first + node->count;
+
+    for (int k = node->first; k < end; k++) {
+        v128_t rx = wasm_f32x4_sub(x, wasm_f32x4_splat(tree->x[k]));
+        v128_t ry = wasm_f32x4_sub(y, wasm_f32x4_splat(tree->y[k]));
+        v128_t rz = wasm_f32x4_sub(z, wasm_f32x4_splat(tree->z[k]));
+        v128_t r2 = wasm_f32x4_add(wasm_f32x4_add(wasm_f32x4_mul(rx, rx), wasm_f32x4_mul(ry, ry)), wasm_f32x4_mul(rz, rz));
+        v128_t rInv = wasm_f32x4_div(wasm_f32x4_splat(1.0f), wasm_f32x4_sqrt(r2));
+        if (k < sourceEnd) minSourceSq = wasm_f32x4_pmin(minSourceSq, r2);
+
+        v128_t s = wasm_f32x4_mul(wasm_f32x4_mul(wasm_f32x4_mul(wasm_f32x4_splat(tree->q[k]), rInv), rInv), rInv);
+        dx = wasm_f32x4_add(dx, wasm_f32x4_mul(s, rx));
+        dy = wasm_f32x4_add(dy, wasm_f32x4_mul(s, ry));
+        dz = wasm_f32x4_add(dz, wasm_f32x4_mul(s, rz));
+    }
+
+    v128_t liveMask = LaneMaskSIMD128(live);
+    wasm_v128_store(lanes->ex + first, wasm_f32x4_add(wasm_v128_load(lanes->ex + first), wasm_v128_and(liveMask, dx)));
+    wasm_v128_store(lanes->ey + first, wasm_f32x4_add(wasm_v128_load(lanes->ey + first), wasm_v128_and(liveMask, dy)));
+    wasm_v128_store(lanes->ez + first, wasm_f32x4_add(wasm_v128_load(lanes->ez + first), wasm_v128_and(liveMask, dz)));
+    v128_t oldSourceSq = wasm_v128_load(lanes->minSourceDistSq + first);
+    wasm_v128_store(lanes->minSourceDistSq + first, wasm_v128_bitselect(wasm_f32x4_pmin(oldSourceSq, minSourceSq), oldSourceSq, liveMask));
+}
+
+#else
+static unsigned int AccumulateCell(const FieldTreeNode *node, FieldPacket *lanes, int first, unsigned int live, float thetaSq) {
+    unsigned int open = 0;
+
+    for (int i = 0; i < FIELD_TREE_GROUP; i++) {
+        if (!(live & (1u << i))) continue;
+        int lane = first + i;
+        float x = lanes->x[lane], y = lanes->y[lane], z = lanes->z[lane];
+        float rx = x - node->cx, ry = y - node->cy, rz = z - node->cz;
+        float r2 = rx*rx + ry*ry + rz*rz;
+
+        float bx = fmaxf(fmaxf(node->minX - x, x - node->maxX), 0.0f);
+        float by = fmaxf(fmaxf(node->minY - y, y - node->maxY), 0.0f);
+        float bz = fmaxf(fmaxf(node->minZ - z, z - node->maxZ), 0.0f);
+        float boundsSq = bx*bx + by*by + bz*bz;
+        if (!(node->sizeSq < thetaSq * r2 && boundsSq >= FIELD_SINK_RADIUS_SQ)) {
+            open |= 1u << i;
+            continue;
+        }
+
+        // Monopole plus dipole about the centre
+        float rInv = 1.0f / sqrtf(r2);
+        float r3Inv = rInv * rInv * rInv;
+        float pr = 3.0f * (node->px * rx + node->py * ry + node->pz * rz) * (rInv * rInv);
+        lanes->ex[lane] += (node->q * rx + pr * rx - node->px) * r3Inv;
+        lanes->ey[lane] += (node->q * ry + pr * ry - node->py) * r3Inv;
+        lanes->ez[lane] += (node->q * rz + pr * rz - node->pz) * r3Inv;
+
+        if (node->hasSources) lanes->minSourceDistSq[lane] = fminf(lanes->minSourceDistSq[lane], boundsSq);
+    }
+
+    return open;
+}
+
+static void AccumulateLeaf(const FieldTree *tree, const FieldTreeNode *node, FieldPacket *lanes, int first, unsigned int live) {
+    int sourceEnd = node->first + node->sourceCount, end = node->first + node->count;
+
+    for (int i = 0; i < FIELD_TREE_GROUP; i++) {
+        if (!(live & (1u << i))) continue;
+        int lane = first + i;
+        float dx = 0.0f, dy = 0.0f, dz = 0.0f;
+
+        for (int k = node->first; k < end; k++) {
+            float rx = lanes->x[lane] - tree->x[k];
+            float ry = lanes->y[lane] - tree->y[k];
+            float rz = lanes->z[lane] - tree->z[k];
+            float r2 = rx*rx + ry*ry + rz*rz;
+            float rInv = 1.0f / sqrtf(r2);
+            if (k < sourceEnd) lanes->minSourceDistSq[lane] = fminf(lanes->minSourceDistSq[lane], r2);
+
+            float s = tree->q[k] * rInv * rInv * rInv;
+            dx += s * rx;
+            dy += s * ry;
+            dz += s * rz;
+        }
+
+        lanes->ex[lane] += dx;
+        lanes->ey[lane] += dy;
+        lanes->ez[lane] += dz;
+    }
+}
+#endif
+
+// The packet walks the tree once: each stack entry carries the lanes that still
+// need its cell, a cell is summed as a whole for the lanes it is far enough from
+// and opened for the rest, and leaves are summed directly for the lanes that
+// reach them. Lanes go FIELD_TREE_GROUP at a time, skipping groups with none live.
+void EvaluateFieldTreePacket(const FieldTree *tree, FieldPacket *packet, float theta) {
+    float thetaSq = theta * theta;
+    FieldPacket lanes;
+
+    for (int i = 0; i < FIELD_PACKET_LANES; i++) {
+        lanes.x[i] = i < packet->count ? packet->x[i] : 0.0f;
+        lanes.y[i] = i < packet->count ? packet->y[i] : 0.0f;
+        lanes.z[i] = i < packet->count ? packet->z[i] : 0.0f;
+        lanes.ex[i] = lanes.ey[i] = lanes.ez[i] = 0.0f;
+        lanes.minSourceDistSq[i] = 1.0e8f;
+    }
+
+    int stack[FIELD_TREE_STACK_SIZE];
+    unsigned int stackLanes[FIELD_TREE_STACK_SIZE];
+    int top = 0;
+    if (tree->nodeCount > 0 && packet->count > 0) {
+        stack[top] = 0;
+        stackLanes[top++] = (1u << packet->count) - 1;
+    }
+
+    while (top > 0) {
+        top--;
+        const FieldTreeNode *node = &tree->nodes[stack[top]];
+        unsigned int active = stackLanes[top];
+
+        if (node->child < 0) {
+            for (int first = 0; first < FIELD_PACKET_LANES; first += FIELD_TREE_GROUP) {
+                unsigned int live = (active >> first) & 0xFu;
+                if (live) AccumulateLeaf(tree, node, &lanes, first, live);
+            }
+            continue;
+        }
+
+        unsigned int open = 0;
+        for (int first = 0; first < FIELD_PACKET_LANES; first += FIELD_TREE_GROUP) {
+            unsigned int live = (active >> first) & 0xFu;
+            if (live) open |= AccumulateCell(node, &lanes, first, live, thetaSq) << first;
+        }
+
+        for (int c = node->child + node->childCount - 1; open && c >= node->child; c--) {
+            stack[top] = c;
+            stackLanes[top++] = open;
+        }
+    }
+
+    for (int i = 0; i < packet->count; i++) {
+        packet->ex[i] = lanes.ex[i];
+        packet->ey[i] = lanes.ey[i];
+        packet->ez[i] = lanes.ez[i];
+        packet->minSourceDistSq[i] = lanes.minSourceDistSq[i];
+    }
+}
+
+float EvaluatePotentialTree(const FieldTree *tree, Vector3 p, float theta) {
+    float thetaSq = theta * theta;
+    float potential = 0.0f;
+    int stack[FIELD_TREE_STACK_SIZE];
+    int top = 0;
+    if (tree->nodeCount > 0) stack[top++] = 0;
+
+    while (top > 0) {
+        const FieldTreeNode *node = &tree->nodes[stack[--top]];
+        float rx = p.x - node->cx, ry = p.y - node->cy, rz = p.z - node->cz;
+        float r2 = rx*rx + ry*ry + rz*rz;
+
+        if (node->sizeSq < thetaSq * r2) {
+            float rInv = 1.0f / sqrtf(r2);
+            potential += (node->q + (node->px * rx + node->py * ry + node->pz * rz) * (rInv * rInv)) * rInv;
+        }
+        else if (node->child < 0) {
+            for (int k = node->first; k < node->first + node->count; k++) {
+                float dx = p.x - tree->x[k], dy = p.y - tree->y[k], dz = p.z - tree->z[k];
+                potential += tree->q[k] / sqrtf(dx*dx + dy*dy + dz*dz);
+            }
+        }
+        else {
+            for (int c = node->child + node->childCount - 1; c >= node->child; c--) stack[top++] = c;
+        }
+    }
+
+    return potential;
+}
+
+void AccumulateFieldTreeLeaf(const FieldTree *tree, int leaf, FieldPacket *packet, unsigned int lanes) {
+    for (int first = 0; first < FIELD_PACKET_LANES; first += FIELD_TREE_GROUP) {
+        unsigned int live = (lanes >> first) & 0xFu;
+        if (live) AccumulateLeaf(tree, &tree->nodes[leaf], packet, first, live);
+    }
+}
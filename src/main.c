@@ -1,23 +1,62 @@
 #include "raylib.h"
 #include "raymath.h"
 #include "rlgl.h"
+#include "fieldlines.h"
 #include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if defined(PLATFORM_WEB)
     #include <emscripten/emscripten.h>
     #include <emscripten/html5.h>
+    #include <GLES2/gl2.h>
+#elif defined(__APPLE__)
+    #include <OpenGL/gl3.h>
+#else
+    #include <GL/gl.h>
 #endif
 
-#define MAX_CHARGES 100
-#define FIELD_LINE_STEP_SIZE 0.05f
+#define LINE_MESH_CHUNK_VERTICES 65536
+#define FIELD_GRID_REBUILD_INTERVAL 64
+#define FIELD_GRID_SOFTENING 1e-4f
+#define FIELD_GRID_BUDGET 0.004         // seconds of overlay resampling allowed per frame
+#define CHARGE_MESH_CHUNK_CHARGES (LINE_MESH_CHUNK_VERTICES / 6)  // six marker vertices per charge
+#define CHARGE_MARKER_SIZE 0.25f        // half-length of each arm of a charge's marker cross
+#define CHARGE_DETAIL_LIMIT 512         // most charges drawn as spheres with labels in a frame
+#define CHARGE_DETAIL_DISTANCE 10.0f    // past CHARGE_DETAIL_LIMIT charges, only those this near the camera are
+#define CHARGE_PICK_RADIUS 20.0f        // pixels from a charge's centre that select it
+
+// One retained GPU buffer holding up to LINE_MESH_CHUNK_VERTICES line vertices
+typedef struct LineMeshChunk {
+    unsigned int vaoId;
+    unsigned int vboId;
+    int vertexCount;
+} 
+LineMeshChunk;
+
+// Potential and E sampled on a regular lattice (a single layer for the ground
+// plane); kept current by superposition deltas after single-charge edits
+typedef struct FieldGrid {
+    int nx, ny, nz;
+    Vector3 origin;
+    float spacing;
+    float *potential;
+    float *ex, *ey, *ez;
+    unsigned int version;           // chargeVersion the samples match
+    int deltasSinceRebuild;
+    int rowsDone;                   // rows (constant z) of a resample filled so far
+} 
+FieldGrid;
 
-typedef struct Charge {
-    Vector3 position;
-    float value;
+typedef enum FieldOverlay {
+    OVERLAY_OFF = 0,
+    OVERLAY_POTENTIAL,
+    OVERLAY_FIELD_STRENGTH,
+    OVERLAY_COUNT
 } 
-Charge;
+FieldOverlay;
 
 const int initialWidth = 1920;
 const int initialHeight = 1080;
@@ -38,8 +77,77 @@ float cameraPitch = 0.0f;
 bool isCameraFirstFrame = true;
 
 //simulation Settings
-int fieldLineSteps = 3000;
-int lineResolution = 2;
+float fieldLineLength = 150.0f;  // arc length of a field line
+float linesPerCharge = 3.2f;     // field lines per unit of positive charge
+int lineBudget = FIELD_LINE_DEFAULT_BUDGET;                 // hard cap on the field lines of all charges together
+int minLinesPerSource = FIELD_LINE_DEFAULT_MIN_PER_SOURCE;  // lines each positive charge gets while the budget allows
+FieldPrecision fieldPrecision = FIELD_PRECISION_EXACT;    // how the kernels compute 1/r
+float treeTheta = FIELD_TREE_DEFAULT_THETA;     // Barnes-Hut opening angle, used above FIELD_TREE_MIN_CHARGES
+int fmmOrder = 0;                               // multipole expansion order in place of the tree, 0 when off
+int latticeResolution = 0;                      // nodes per side of the interpolated field lattice, 0 for off; used from FIELD_LATTICE_MIN_CHARGES
+
+float traceBudget = 0.008f;     // seconds of tracing allowed per frame
+
+//drag preview tier: used while a charge is dragged if a full trace would cost
+//more than previewWorkThreshold charge evaluations; refined on mouse release
+double previewWorkThreshold = 2.0e6;
+float evaluationsPerUnit = 5.0f;        // typical field evaluations per unit of line length
+float previewLineScale = 0.25f;         // fraction of the lines per charge and of the line budget
+float previewToleranceScale = 4.0f;     // integration tolerance multiplier
+float previewLengthScale = 0.5f;        // fraction of the full line length
+
+//after a single-charge edit only lines whose relative field perturbation
+//|dE|/|E| exceeds this tolerance are retraced
+float retraceTolerance = 0.02f;
+
+//scene versioning: bumped by every edit that changes the traced geometry
+unsigned int sceneVersion = 1;
+unsigned int submittedVersion = 0;  // version of the newest trace job
+unsigned int tracedVersion = 0;     // version whose lines are all traced
+bool submittedPreview = false;
+
+//last single-charge edit, usable for a selective retrace when it is the
+//only change since the previous trace (pendingEditVersion == sceneVersion)
+ChargeEdit pendingEdit = { 0 };
+unsigned int pendingEditVersion = 0;
+unsigned int chargeVersion = 1;     // bumped only by edits to charges[]
+
+//ground-plane field overlay
+FieldGrid groundGrid = { 0 };
+FieldGrid groundGridNext = { 0 };   // full resample in progress, swapped in when done
+FieldTree groundGridTree = { 0 };   // charges the resample reads past FIELD_TREE_MIN_CHARGES
+Texture2D groundGridTexture = { 0 };
+Color *groundGridPixels = NULL;
+FieldOverlay fieldOverlay = OVERLAY_OFF;
+FieldOverlay groundGridTextureMode = OVERLAY_OFF;
+unsigned int groundGridTextureVersion = 0;
+
+#if !defined(TRACE_THREADED)
+//lines traced progressively on the main thread (threaded builds keep theirs in the worker)
+LineSet frontLines = { 0 };
+TraceState traceState = { 0 };
+#endif
+
+//retained GPU copy of the line cache
+LineMeshChunk *lineMeshChunks = NULL;
+int lineMeshChunkCount = 0;
+int lineMeshChunkCapacity = 0;
+int lineMeshVertexCount = 0;    // vertices of the front LineSet already uploaded
+
+//retained GPU markers of every charge, drawn instead of spheres past CHARGE_DETAIL_LIMIT
+LineMeshChunk *chargeMeshChunks = NULL;
+int chargeMeshChunkCount = 0;
+int chargeMeshChunkCapacity = 0;
+unsigned int chargeMeshVersion = 0;     // chargeVersion the markers match
+
+//generated scenes ([N] cycles through them); the web build traces on the main
+//thread and builds the tree there too, which takes a frame or more past 10000
+#if defined(PLATFORM_WEB)
+const int sceneSizes[] = { 4, 1000, 10000 };
+#else
+const int sceneSizes[] = { 4, 1000, 10000, 100000, MAX_CHARGES };
+#endif
+int sceneSize = 4;
 
 //UI State
 char chargeInput[16] = "";
@@ -81,17 +189,480 @@ bool GetGroundIntersection(Ray ray, Vector3 *outPos) {
     return true;
 }
 
-Color CustomColorLerp(Color c1, Color c2, float amount) {
-    if (amount <= 0.0f) return c1;
-    if (amount >= 1.0f) return c2;
-    int iAmount = (int)(amount * 256.0f);
-    int invAmount = 256 - iAmount;
-    return (Color){
-        (unsigned char)((c1.r * invAmount + c2.r * iAmount) >> 8),
-        (unsigned char)((c1.g * invAmount + c2.g * iAmount) >> 8),
-        (unsigned char)((c1.b * invAmount + c2.b * iAmount) >> 8),
-        255
-    };
+void MarkSceneChanged(void) {
+    sceneVersion++;
+}
+
+// Like MarkSceneChanged, but remembers the edit so the next trace can be selective
+void RecordChargeEdit(int index, Charge before, Charge after) {
+    pendingEdit = (ChargeEdit){ index, before, after };
+    sceneVersion++;
+    pendingEditVersion = sceneVersion;
+    chargeVersion++;
+}
+
+TraceQuality ResolveTraceQuality(void) {
+    TraceQuality quality = { linesPerCharge, lineBudget, minLinesPerSource, fieldLineLength, FIELD_LINE_DEFAULT_TOLERANCE, fieldPrecision, 0.0f, 0, 0, false };
+    if (numCharges >= FIELD_LATTICE_MIN_CHARGES) quality.latticeResolution = latticeResolution;
+    if (numCharges > FIELD_TREE_MIN_CHARGES) {
+        if (fmmOrder > 0) quality.fmmOrder = fmmOrder;
+        else quality.treeTheta = treeTheta;
+    }
+
+    // Past the threshold a tree evaluation costs about what a direct one does at it
+    int evaluationCost = numCharges > FIELD_TREE_MIN_CHARGES ? FIELD_TREE_MIN_CHARGES : numCharges;
+    double evaluationsPerLine = fieldLineLength * evaluationsPerUnit;
+    double fullWork = (double)CountFieldLines(charges, numCharges, &quality) * evaluationsPerLine * evaluationCost;
+    if (selectedCharge != -1 && fullWork > previewWorkThreshold) {
+        quality.linesPerCharge *= previewLineScale;
+        quality.lineBudget = (int)(lineBudget * previewLineScale);
+        quality.tolerance *= previewToleranceScale;
+        quality.length = fieldLineLength * previewLengthScale;
+        quality.preview = true;
+
+        // Rebuilding the expansions or resampling the lattice every drag frame
+        // costs more than the preview trace itself; the tree rebuilds in milliseconds
+        if (quality.fmmOrder > 0) {
+            quality.fmmOrder = 0;
+            quality.treeTheta = treeTheta;
+        }
+        quality.latticeResolution = 0;
+    }
+
+    return quality;
+}
+
+// Snapshots the scene for the tracer
+TraceJob BuildTraceJob(void) {
+    TraceJob job = { 0 };
+
+    job.version = sceneVersion;
+    job.chargeVersion = chargeVersion;
+    job.charges = malloc(numCharges * sizeof(Charge) + 1);
+    if (job.charges) memcpy(job.charges, charges, numCharges * sizeof(Charge));
+    job.numCharges = job.charges ? numCharges : 0;
+    job.quality = ResolveTraceQuality();
+    job.hasEdit = pendingEditVersion == sceneVersion;
+    job.edit = pendingEdit;
+    job.retraceTolerance = retraceTolerance;
+    job.cacheable = !job.quality.preview && selectedCharge == -1;
+
+    submittedVersion = sceneVersion;
+    submittedPreview = job.quality.preview;
+    return job;
+}
+
+void BindLineMeshAttributes(void) {
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 3, RL_FLOAT, false, 
+                         sizeof(FieldLineVertex), offsetof(FieldLineVertex, position));
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+    rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, 4, RL_UNSIGNED_BYTE, true, 
+                         sizeof(FieldLineVertex), offsetof(FieldLineVertex, color));
+    rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR);
+}
+
+LineMeshChunk LoadLineMeshChunk(void) {
+    LineMeshChunk chunk = { 0 };
+
+    // vaoId stays 0 where VAOs are unsupported (WebGL 1 without the extension)
+    chunk.vaoId = rlLoadVertexArray();
+    rlEnableVertexArray(chunk.vaoId);
+    chunk.vboId = rlLoadVertexBuffer(NULL, LINE_MESH_CHUNK_VERTICES * sizeof(FieldLineVertex), true);
+    BindLineMeshAttributes();
+    rlDisableVertexArray();
+    rlDisableVertexBuffer();
+
+    return chunk;
+}
+
+// Uploads the vertices traced since the last sync; everything else stays on the GPU
+void SyncLineMesh(const LineSet *lines) {
+    if (lines->vertexCount < lineMeshVertexCount) lineMeshVertexCount = lines->vertexCount;
+
+    while (lineMeshVertexCount < lines->vertexCount) {
+        int chunkIndex = lineMeshVertexCount / LINE_MESH_CHUNK_VERTICES;
+        int chunkOffset = lineMeshVertexCount % LINE_MESH_CHUNK_VERTICES;
+
+        if (chunkIndex >= lineMeshChunkCount) {
+            if (lineMeshChunkCount == lineMeshChunkCapacity) {
+                int newCapacity = lineMeshChunkCapacity ? lineMeshChunkCapacity * 2 : 8;
+                LineMeshChunk *grown = realloc(lineMeshChunks, newCapacity * sizeof(LineMeshChunk));
+                if (!grown) return;
+                lineMeshChunks = grown;
+                lineMeshChunkCapacity = newCapacity;
+            }
+            lineMeshChunks[lineMeshChunkCount++] = LoadLineMeshChunk();
+        }
+
+        int count = lines->vertexCount - lineMeshVertexCount;
+        if (count > LINE_MESH_CHUNK_VERTICES - chunkOffset) count = LINE_MESH_CHUNK_VERTICES - chunkOffset;
+
+        rlUpdateVertexBuffer(lineMeshChunks[chunkIndex].vboId, lines->vertices + lineMeshVertexCount, 
+                             count * sizeof(FieldLineVertex), chunkOffset * sizeof(FieldLineVertex));
+        lineMeshVertexCount += count;
+    }
+
+    for (int i = 0; i < lineMeshChunkCount; i++) {
+        int count = lineMeshVertexCount - i * LINE_MESH_CHUNK_VERTICES;
+        if (count < 0) count = 0;
+        if (count > LINE_MESH_CHUNK_VERTICES) count = LINE_MESH_CHUNK_VERTICES;
+        lineMeshChunks[i].vertexCount = count;
+    }
+}
+
+// Draws retained line chunks: one draw call per chunk, no per-vertex CPU work
+void DrawLineMeshChunks(const LineMeshChunk *chunks, int chunkCount) {
+    rlDrawRenderBatchActive();
+
+    int *locs = rlGetShaderLocsDefault();
+    Matrix mvp = MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+    float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    rlEnableShader(rlGetShaderIdDefault());
+    rlSetUniformMatrix(locs[RL_SHADER_LOC_MATRIX_MVP], mvp);
+    rlSetUniform(locs[RL_SHADER_LOC_COLOR_DIFFUSE], white, RL_SHADER_UNIFORM_VEC4, 1);
+    rlActiveTextureSlot(0);
+    rlEnableTexture(rlGetTextureIdDefault());
+
+    for (int i = 0; i < chunkCount; i++) {
+        if (chunks[i].vertexCount == 0) continue;
+        if (!rlEnableVertexArray(chunks[i].vaoId)) {
+            rlEnableVertexBuffer(chunks[i].vboId);
+            BindLineMeshAttributes();
+        }
+        glDrawArrays(GL_LINES, 0, chunks[i].vertexCount);
+    }
+
+    rlDisableVertexArray();
+    rlDisableVertexBuffer();
+    rlDisableTexture();
+    rlDisableShader();
+}
+
+void DrawFieldLines(void) {
+    DrawLineMeshChunks(lineMeshChunks, lineMeshChunkCount);
+}
+
+void UnloadLineMesh(void) {
+    for (int i = 0; i < lineMeshChunkCount; i++) {
+        rlUnloadVertexArray(lineMeshChunks[i].vaoId);
+        rlUnloadVertexBuffer(lineMeshChunks[i].vboId);
+    }
+    free(lineMeshChunks);
+    lineMeshChunks = NULL;
+    lineMeshChunkCount = lineMeshChunkCapacity = lineMeshVertexCount = 0;
+}
+
+// Cross of three axis-aligned segments marking a charge, six vertices
+void WriteChargeMarker(FieldLineVertex *out, Charge c) {
+    Color color = c.value > 0 ? BLUE : RED;
+    for (int axis = 0; axis < 3; axis++) {
+        Vector3 arm = { axis == 0 ? CHARGE_MARKER_SIZE : 0.0f, axis == 1 ? CHARGE_MARKER_SIZE : 0.0f, axis == 2 ? CHARGE_MARKER_SIZE : 0.0f };
+        out[2 * axis] = (FieldLineVertex){ Vector3Subtract(c.position, arm), color };
+        out[2 * axis + 1] = (FieldLineVertex){ Vector3Add(c.position, arm), color };
+    }
+}
+
+// Brings the markers up to date with charges[]: a lone move or addition since
+// the last sync rewrites that charge's vertices, anything else re-uploads them all
+void SyncChargeMesh(void) {
+    if (chargeMeshVersion == chargeVersion) return;
+
+    int needed = (numCharges + CHARGE_MESH_CHUNK_CHARGES - 1) / CHARGE_MESH_CHUNK_CHARGES;
+    if (needed > chargeMeshChunkCapacity) {
+        LineMeshChunk *grown = realloc(chargeMeshChunks, needed * sizeof(LineMeshChunk));
+        if (!grown) return;
+        chargeMeshChunks = grown;
+        chargeMeshChunkCapacity = needed;
+    }
+    while (chargeMeshChunkCount < needed) chargeMeshChunks[chargeMeshChunkCount++] = LoadLineMeshChunk();
+
+    if (chargeMeshVersion + 1 == chargeVersion && pendingEdit.after.value != 0.0f) {
+        FieldLineVertex marker[6];
+        int index = pendingEdit.index;
+        WriteChargeMarker(marker, charges[index]);
+        rlUpdateVertexBuffer(chargeMeshChunks[index / CHARGE_MESH_CHUNK_CHARGES].vboId, marker, sizeof(marker), 
+                             (index % CHARGE_MESH_CHUNK_CHARGES) * sizeof(marker));
+    } else {
+        FieldLineVertex *vertices = malloc(CHARGE_MESH_CHUNK_CHARGES * 6 * sizeof(FieldLineVertex));
+        if (!vertices) return;
+        for (int chunk = 0; chunk < needed; chunk++) {
+            int first = chunk * CHARGE_MESH_CHUNK_CHARGES;
+            int count = numCharges - first < CHARGE_MESH_CHUNK_CHARGES ? numCharges - first : CHARGE_MESH_CHUNK_CHARGES;
+            for (int i = 0; i < count; i++) WriteChargeMarker(vertices + 6 * i, charges[first + i]);
+            rlUpdateVertexBuffer(chargeMeshChunks[chunk].vboId, vertices, count * 6 * sizeof(FieldLineVertex), 0);
+        }
+        free(vertices);
+    }
+
+    for (int chunk = 0; chunk < chargeMeshChunkCount; chunk++) {
+        int count = numCharges - chunk * CHARGE_MESH_CHUNK_CHARGES;
+        if (count < 0) count = 0;
+        if (count > CHARGE_MESH_CHUNK_CHARGES) count = CHARGE_MESH_CHUNK_CHARGES;
+        chargeMeshChunks[chunk].vertexCount = 6 * count;
+    }
+    chargeMeshVersion = chargeVersion;
+}
+
+void UnloadChargeMesh(void) {
+    for (int i = 0; i < chargeMeshChunkCount; i++) {
+        rlUnloadVertexArray(chargeMeshChunks[i].vaoId);
+        rlUnloadVertexBuffer(chargeMeshChunks[i].vboId);
+    }
+    free(chargeMeshChunks);
+    chargeMeshChunks = NULL;
+    chargeMeshChunkCount = chargeMeshChunkCapacity = 0;
+    chargeMeshVersion = 0;
+}
+
+// Charges drawn as spheres with labels: all of a small scene; in a large one the
+// selected charge and the first CHARGE_DETAIL_LIMIT found in front of the camera
+// within CHARGE_DETAIL_DISTANCE of it. Returns how many were written to out.
+int CollectDetailCharges(int *out) {
+    int count = 0;
+    if (numCharges <= CHARGE_DETAIL_LIMIT) {
+        for (int i = 0; i < numCharges; i++) out[count++] = i;
+        return count;
+    }
+
+    if (selectedCharge != -1) out[count++] = selectedCharge;
+    Vector3 forward = Vector3Subtract(camera.target, camera.position);
+    for (int i = 0; i < numCharges && count < CHARGE_DETAIL_LIMIT; i++) {
+        Vector3 offset = Vector3Subtract(charges[i].position, camera.position);
+        if (i == selectedCharge || Vector3DotProduct(offset, forward) <= 0.0f) continue;
+        if (Vector3LengthSqr(offset) < CHARGE_DETAIL_DISTANCE * CHARGE_DETAIL_DISTANCE) out[count++] = i;
+    }
+    return count;
+}
+
+// The camera's view-projection as GetWorldToScreen builds it, once for many points
+Matrix GetScreenProjection(void) {
+    Matrix projection = MatrixPerspective(camera.fovy * DEG2RAD, (double)GetScreenWidth() / GetScreenHeight(), 
+                                          rlGetCullDistanceNear(), rlGetCullDistanceFar());
+    return MatrixMultiply(MatrixLookAt(camera.position, camera.target, camera.up), projection);
+}
+
+// GetWorldToScreen through a precomputed projection; false behind the camera
+bool ProjectToScreen(Matrix m, Vector3 p, Vector2 *out) {
+    float x = m.m0 * p.x + m.m4 * p.y + m.m8 * p.z + m.m12;
+    float y = m.m1 * p.x + m.m5 * p.y + m.m9 * p.z + m.m13;
+    float w = m.m3 * p.x + m.m7 * p.y + m.m11 * p.z + m.m15;
+    if (w <= 0.0f) return false;
+
+    out->x = (x / w + 1.0f) * 0.5f * GetScreenWidth();
+    out->y = (1.0f - y / w) * 0.5f * GetScreenHeight();
+    return true;
+}
+
+// Charge drawn nearest the mouse, within CHARGE_PICK_RADIUS pixels, or -1
+int PickCharge(Vector2 mouse) {
+    Matrix projection = GetScreenProjection();
+    float bestDistSq = CHARGE_PICK_RADIUS * CHARGE_PICK_RADIUS;
+    int best = -1;
+
+    for (int i = 0; i < numCharges; i++) {
+        Vector2 screenPos;
+        if (!ProjectToScreen(projection, charges[i].position, &screenPos)) continue;
+        float distSq = Vector2DistanceSqr(mouse, screenPos);
+        if (distSq <= bestDistSq) {
+            bestDistSq = distSq;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Replaces the charges with the four-charge square (count 4) or a random slab of
+// count alternating-sign charges, the scene `make bench` measures at that count
+void LoadChargeScene(int count) {
+    if (count == 4) {
+        charges[0] = (Charge){{-8, 0, 8}, 10.0f};
+        charges[1] = (Charge){{8, 0, 8}, -10.0f};
+        charges[2] = (Charge){{8, 0, -8}, 10.0f};
+        charges[3] = (Charge){{-8, 0, -8}, -10.0f};
+    } else {
+        srand(12345 + count);
+        for (int i = 0; i < count; i++) {
+            float x = -20.0f + 40.0f * (rand() / (float)RAND_MAX);
+            float y = -2.0f + 4.0f * (rand() / (float)RAND_MAX);
+            float z = -20.0f + 40.0f * (rand() / (float)RAND_MAX);
+            float magnitude = 1.0f + 9.0f * (rand() / (float)RAND_MAX);
+            charges[i] = (Charge){ { x, y, z }, i % 2 ? -magnitude : magnitude };
+        }
+    }
+
+    numCharges = count;
+    sceneSize = count;
+    selectedCharge = -1;
+    isTyping = false;
+    MarkSceneChanged();
+
+    // Not a lone edit: skipping a version makes the overlay grid and the markers
+    // rebuild instead of applying pendingEdit as a delta
+    chargeVersion += 2;
+}
+
+FieldGrid LoadFieldGrid(int nx, int ny, int nz, Vector3 origin, float spacing) {
+    FieldGrid grid = { .nx = nx, .ny = ny, .nz = nz, .origin = origin, .spacing = spacing };
+    size_t count = (size_t)nx * ny * nz;
+
+    grid.potential = calloc(count, sizeof(float));
+    grid.ex = calloc(count, sizeof(float));
+    grid.ey = calloc(count, sizeof(float));
+    grid.ez = calloc(count, sizeof(float));
+
+    return grid;
+}
+
+void UnloadFieldGrid(FieldGrid *grid) {
+    free(grid->potential);
+    free(grid->ex);
+    free(grid->ey);
+    free(grid->ez);
+    *grid = (FieldGrid){ 0 };
+}
+
+// Adds sign * (contribution of c) to the samples of rows [firstRow, endRow)
+void AccumulateChargeIntoGrid(FieldGrid *grid, Charge c, float sign, int firstRow, int endRow) {
+    float q = sign * c.value;
+    int index = firstRow * grid->ny * grid->nx;
+
+    for (int k = firstRow; k < endRow; k++) {
+        float rz = grid->origin.z + k * grid->spacing - c.position.z;
+        for (int j = 0; j < grid->ny; j++) {
+            float ry = grid->origin.y + j * grid->spacing - c.position.y;
+            for (int i = 0; i < grid->nx; i++, index++) {
+                float rx = grid->origin.x + i * grid->spacing - c.position.x;
+                float r2 = rx*rx + ry*ry + rz*rz + FIELD_GRID_SOFTENING;
+                float rInv = 1.0f / sqrtf(r2);
+                float s = q * rInv * rInv * rInv;
+
+                grid->potential[index] += q * rInv;
+                grid->ex[index] += s * rx;
+                grid->ey[index] += s * ry;
+                grid->ez[index] += s * rz;
+            }
+        }
+    }
+}
+
+// Fills row k of the grid from charges[]: summed directly, or through
+// groundGridTree past FIELD_TREE_MIN_CHARGES, where a row of direct sums would
+// take longer than a frame
+void SampleFieldGridRow(FieldGrid *grid, int k) {
+    size_t first = (size_t)k * grid->ny * grid->nx, count = (size_t)grid->ny * grid->nx;
+
+    if (numCharges <= FIELD_TREE_MIN_CHARGES) {
+        memset(grid->potential + first, 0, count * sizeof(float));
+        memset(grid->ex + first, 0, count * sizeof(float));
+        memset(grid->ey + first, 0, count * sizeof(float));
+        memset(grid->ez + first, 0, count * sizeof(float));
+        for (int c = 0; c < numCharges; c++) AccumulateChargeIntoGrid(grid, charges[c], 1.0f, k, k + 1);
+        return;
+    }
+
+    FieldPacket packet;
+    float z = grid->origin.z + k * grid->spacing;
+    for (size_t start = 0; start < count; start += FIELD_PACKET_LANES) {
+        packet.count = 0;
+        for (size_t index = start; index < count && packet.count < FIELD_PACKET_LANES; index++) {
+            packet.x[packet.count] = grid->origin.x + (index % grid->nx) * grid->spacing;
+            packet.y[packet.count] = grid->origin.y + (index / grid->nx) * grid->spacing;
+            packet.z[packet.count++] = z;
+        }
+        EvaluateFieldTreePacket(&groundGridTree, &packet, FIELD_TREE_DEFAULT_THETA);
+
+        for (int lane = 0; lane < packet.count; lane++) {
+            Vector3 p = { packet.x[lane], packet.y[lane], packet.z[lane] };
+            grid->potential[first + start + lane] = EvaluatePotentialTree(&groundGridTree, p, FIELD_TREE_DEFAULT_THETA);
+            grid->ex[first + start + lane] = packet.ex[lane];
+            grid->ey[first + start + lane] = packet.ey[lane];
+            grid->ez[first + start + lane] = packet.ez[lane];
+        }
+    }
+}
+
+// Brings the grid up to date with charges[]: a lone edit since the last update
+// is applied at once as its (new - old) contribution. Anything else, and every
+// FIELD_GRID_REBUILD_INTERVAL deltas in a row (to bound float drift), resamples
+// the grid into next for at most FIELD_GRID_BUDGET a frame and swaps it in when
+// done. Resamples wait for a drag to end, since each of its edits restarts them.
+void UpdateFieldGrid(FieldGrid *grid, FieldGrid *next) {
+    if (grid->version + 1 == chargeVersion) {
+        int rows = grid->nz;
+        if (pendingEdit.before.value != 0.0f) AccumulateChargeIntoGrid(grid, pendingEdit.before, -1.0f, 0, rows);
+        if (pendingEdit.after.value != 0.0f) AccumulateChargeIntoGrid(grid, pendingEdit.after, 1.0f, 0, rows);
+        grid->deltasSinceRebuild++;
+        grid->version = chargeVersion;
+    }
+
+    bool stale = grid->version != chargeVersion || grid->deltasSinceRebuild >= FIELD_GRID_REBUILD_INTERVAL;
+    if (!stale || selectedCharge != -1) return;
+
+    if (next->version != chargeVersion) {
+        next->version = chargeVersion;
+        next->rowsDone = 0;
+        if (numCharges > FIELD_TREE_MIN_CHARGES) SyncFieldTree(&groundGridTree, charges, numCharges, chargeVersion);
+    }
+
+    double start = GetTime();
+    while (next->rowsDone < next->nz && GetTime() - start < FIELD_GRID_BUDGET) 
+        SampleFieldGridRow(next, next->rowsDone++);
+    if (next->rowsDone < next->nz) return;
+
+    FieldGrid done = *next;
+    *next = *grid;
+    *grid = done;
+    grid->deltasSinceRebuild = 0;
+    next->version = 0;
+}
+
+// Maps the ground grid onto its overlay texture with a log-scaled color ramp
+void UpdateGroundGridTexture(void) {
+    int count = groundGrid.nx * groundGrid.nz;
+
+    for (int i = 0; i < count; i++) {
+        Color c;
+        if (fieldOverlay == OVERLAY_POTENTIAL) {
+            float v = groundGrid.potential[i];
+            float t = fminf(log1pf(fabsf(v)) / 4.0f, 1.0f);
+            c = CustomColorLerp(BLACK, v > 0 ? BLUE : RED, t);
+        } else {
+            float e = sqrtf(groundGrid.ex[i]*groundGrid.ex[i] + groundGrid.ey[i]*groundGrid.ey[i] + groundGrid.ez[i]*groundGrid.ez[i]);
+            float t = fminf(log1pf(e) / 4.0f, 1.0f);
+            c = t < 0.5f ? CustomColorLerp(BLACK, PURPLE, 2.0f * t) : CustomColorLerp(PURPLE, YELLOW, 2.0f * t - 1.0f);
+        }
+        groundGridPixels[i] = c;
+    }
+
+    UpdateTexture(groundGridTexture, groundGridPixels);
+    groundGridTextureMode = fieldOverlay;
+    groundGridTextureVersion = groundGrid.version;
+}
+
+void DrawFieldOverlay(void) {
+    if (fieldOverlay == OVERLAY_OFF) return;
+
+    UpdateFieldGrid(&groundGrid, &groundGridNext);
+    if (groundGridTextureVersion != groundGrid.version || groundGridTextureMode != fieldOverlay) 
+        UpdateGroundGridTexture();
+
+    // Texel centers sit on the grid samples
+    float x0 = groundGrid.origin.x - 0.5f * groundGrid.spacing;
+    float z0 = groundGrid.origin.z - 0.5f * groundGrid.spacing;
+    float x1 = x0 + groundGrid.nx * groundGrid.spacing;
+    float z1 = z0 + groundGrid.nz * groundGrid.spacing;
+    float y = -0.01f;
+
+    rlSetTexture(groundGridTexture.id);
+    rlBegin(RL_QUADS);
+        rlColor4ub(255, 255, 255, 160);
+        rlTexCoord2f(0.0f, 0.0f); rlVertex3f(x0, y, z0);
+        rlTexCoord2f(0.0f, 1.0f); rlVertex3f(x0, y, z1);
+        rlTexCoord2f(1.0f, 1.0f); rlVertex3f(x1, y, z1);
+        rlTexCoord2f(1.0f, 0.0f); rlVertex3f(x1, y, z0);
+    rlEnd();
+    rlSetTexture(0);
 }
 
 // Resize callback
@@ -169,19 +740,88 @@ void UpdateDrawFrame(void)
     Ray ray = GetMouseRay(mouse, camera);
 
     // Line density and draw length
+    float prevLength = fieldLineLength;
+    float prevLines = linesPerCharge;
+
     if (IsKeyDown(KEY_UP)) 
-        fieldLineSteps += 5;
+        fieldLineLength += 0.25f;
 
     if (IsKeyDown(KEY_DOWN)) 
-        if ((fieldLineSteps -= 5) < 10) 
-            fieldLineSteps = 10;
+        if ((fieldLineLength -= 0.25f) < 0.5f) 
+            fieldLineLength = 0.5f;
 
     if (IsKeyPressed(KEY_RIGHT)) 
-        lineResolution++;
+        linesPerCharge *= 1.25f;
 
     if (IsKeyPressed(KEY_LEFT)) 
-        if (--lineResolution < 1) 
-            lineResolution = 1;
+        if ((linesPerCharge /= 1.25f) < 0.1f) 
+            linesPerCharge = 0.1f;
+
+    if (fieldLineLength != prevLength || linesPerCharge != prevLines) 
+        MarkSceneChanged();
+
+    if (IsKeyPressed(KEY_G)) 
+        fieldOverlay = (fieldOverlay + 1) % OVERLAY_COUNT;
+
+    if (IsKeyPressed(KEY_P)) {
+        fieldPrecision = (fieldPrecision + 1) % FIELD_PRECISION_COUNT;
+        MarkSceneChanged();
+    }
+
+    // Opening angle of the tree (only retraces when the tree is in use)
+    if (IsKeyPressed(KEY_T)) {
+        const float thetas[] = { 0.3f, 0.5f, 0.7f, 1.0f };
+        int count = sizeof(thetas) / sizeof(thetas[0]), next = 0;
+        while (next < count && thetas[next] <= treeTheta) next++;
+        treeTheta = thetas[next % count];
+        if (numCharges > FIELD_TREE_MIN_CHARGES && fmmOrder == 0) MarkSceneChanged();
+    }
+
+#if !defined(PLATFORM_WEB)
+    // Interpolated field lattice: off, then coarse to fine (only retraces when the scene is large enough to use it).
+    // Native only, like the multipole evaluator: the web build would sample it on the main thread, stalling for seconds
+    if (IsKeyPressed(KEY_L)) {
+        const int resolutions[] = { 0, 96, 128 };
+        int count = sizeof(resolutions) / sizeof(resolutions[0]), next = 0;
+        while (next < count && resolutions[next] <= latticeResolution) next++;
+        latticeResolution = resolutions[next % count];
+        if (numCharges >= FIELD_LATTICE_MIN_CHARGES) MarkSceneChanged();
+    }
+
+    // Multipole evaluator: off, then expansion orders 1 to 8 (only retraces when the scene is large enough to use it)
+    if (IsKeyPressed(KEY_O)) {
+        fmmOrder = (fmmOrder + 1) % (FIELD_FMM_MAX_ORDER + 1);
+        if (numCharges > FIELD_TREE_MIN_CHARGES) MarkSceneChanged();
+    }
+#endif
+
+    // Total line budget and the per-charge minimum it shares out first
+    if (IsKeyPressed(KEY_B)) {
+        const int budgets[] = { 256, 1024, 4096, 16384, 65536 };
+        int count = sizeof(budgets) / sizeof(budgets[0]), next = 0;
+        while (next < count && budgets[next] <= lineBudget) next++;
+        lineBudget = budgets[next % count];
+        MarkSceneChanged();
+    }
+
+    if (IsKeyPressed(KEY_M)) {
+        minLinesPerSource = minLinesPerSource >= 16 ? 1 : minLinesPerSource * 2;
+        MarkSceneChanged();
+    }
+
+    // Generated scenes, cycling through sceneSizes
+    if (IsKeyPressed(KEY_N)) {
+        int count = sizeof(sceneSizes) / sizeof(sceneSizes[0]), next = 0;
+        while (next < count && sceneSizes[next] <= sceneSize) next++;
+        LoadChargeScene(sceneSizes[next % count]);
+    }
+
+    // Selective retrace tolerance (only affects future edits)
+    if (IsKeyPressed(KEY_RIGHT_BRACKET)) 
+        retraceTolerance = fminf(retraceTolerance * 2.0f, 0.64f);
+
+    if (IsKeyPressed(KEY_LEFT_BRACKET)) 
+        retraceTolerance = fmaxf(retraceTolerance * 0.5f, 0.0025f);
 
     
     if (!freeCameraMode) {
@@ -189,14 +829,11 @@ void UpdateDrawFrame(void)
             bool clickedCharge = false;
 
             // First, check if we clicked an EXISTING charge (to select/drag)
-            for (int i = 0; i < numCharges; i++) {
-                Vector2 screenPos = GetWorldToScreen(charges[i].position, camera);
-                if (CheckCollisionPointCircle(mouse, screenPos, 20.0f)) {
-                    selectedCharge = i;
-                    isTyping = false; // Stop typing if we select a charge
-                    clickedCharge = true;
-                    break;
-                }
+            int picked = PickCharge(mouse);
+            if (picked != -1) {
+                selectedCharge = picked;
+                isTyping = false; // Stop typing if we select a charge
+                clickedCharge = true;
             }
 
             // If we clicked EMPTY SPACE
@@ -212,6 +849,7 @@ void UpdateDrawFrame(void)
                     if (val != 0.0f && GetGroundIntersection(ray, &spawnPos)) {
                         if (numCharges < MAX_CHARGES) {
                             charges[numCharges++] = (Charge){spawnPos, val};
+                            RecordChargeEdit(numCharges - 1, (Charge){ 0 }, charges[numCharges - 1]);
                         }
                         // Reset AFTER placing
                         isTyping = false;
@@ -232,23 +870,23 @@ void UpdateDrawFrame(void)
         if (selectedCharge != -1) {
             if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
                 Vector3 groundPos;
-                if (GetGroundIntersection(ray, &groundPos)) 
+                if (GetGroundIntersection(ray, &groundPos) && 
+                    !Vector3Equals(groundPos, charges[selectedCharge].position)) {
+                    Charge before = charges[selectedCharge];
                     charges[selectedCharge].position = groundPos;
+                    RecordChargeEdit(selectedCharge, before, charges[selectedCharge]);
+                }
             } else 
                 selectedCharge = -1;
         }
 
         if (IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) {
-            int deleteIndex = -1;
-            for (int i = 0; i < numCharges; i++) {
-                Vector2 screenPos = GetWorldToScreen(charges[i].position, camera);
-                if (CheckCollisionPointCircle(mouse, screenPos, 20.0f)) {
-                    deleteIndex = i; break;
-                }
-            }
+            int deleteIndex = PickCharge(mouse);
             if (deleteIndex != -1) {
+                Charge before = charges[deleteIndex];
                 for (int k = deleteIndex; k < numCharges - 1; k++) charges[k] = charges[k + 1];
                 numCharges--; isTyping = false;
+                RecordChargeEdit(deleteIndex, before, (Charge){ 0 });
             }
         }
     }
@@ -267,123 +905,84 @@ void UpdateDrawFrame(void)
             if (numCharges < MAX_CHARGES && inputLength > 0) {
                 float val = strtof(chargeInput, NULL);
                 Vector3 spawnPos;
-                if (val != 0.0f && GetGroundIntersection(ray, &spawnPos)) 
+                if (val != 0.0f && GetGroundIntersection(ray, &spawnPos)) {
                     charges[numCharges++] = (Charge){spawnPos, val};
+                    RecordChargeEdit(numCharges - 1, (Charge){ 0 }, charges[numCharges - 1]);
+                }
             }
             isTyping = false;
         }
         if (IsKeyPressed(KEY_ESCAPE)) isTyping = false;
     }
 
+    // Retrace only when the scene changed since the cache was built, and never 
+    // for longer than traceBudget per frame; partial results are drawn as they land
+    // A preview traced during a drag is refined to full quality once it ends
+    if (submittedPreview && selectedCharge == -1) 
+        MarkSceneChanged();
+
+#if defined(TRACE_THREADED)
+    // The worker traces off the main thread; swapped-in geometry is re-uploaded whole
+    if (submittedVersion != sceneVersion) 
+        SubmitTraceJob(BuildTraceJob());
+
+    bool published = false;
+    const LineSet *front = AcquireFrontLines(&published);
+    if (published) {
+        lineMeshVertexCount = 0;
+        SyncLineMesh(front);
+        if (front->version) tracedVersion = front->version;
+    }
+    ReleaseFrontLines();
+#else
+    if (submittedVersion != sceneVersion) {
+        BeginTrace(&traceState, BuildTraceJob(), &frontLines, &frontLines);
+        if (traceState.firstChangedVertex < lineMeshVertexCount) 
+            lineMeshVertexCount = traceState.firstChangedVertex;
+    }
+
+    if (tracedVersion != sceneVersion) {
+        ContinueTrace(&traceState, traceBudget);
+        SyncLineMesh(&frontLines);
+        if (frontLines.version) tracedVersion = frontLines.version;
+    }
+#endif
+
     // Render
+    static int detailCharges[CHARGE_DETAIL_LIMIT];
+    int detailCount = CollectDetailCharges(detailCharges);
+    if (numCharges > CHARGE_DETAIL_LIMIT) SyncChargeMesh();
+
     BeginDrawing();
     ClearBackground(BLACK);
 
     BeginMode3D(camera);
+        DrawFieldOverlay();
         DrawInfiniteGrid();
 
-        for (int i = 0; i < numCharges; i++) {
+        // Large scenes draw every charge as a retained marker, spheres only up close
+        if (numCharges > CHARGE_DETAIL_LIMIT) DrawLineMeshChunks(chargeMeshChunks, chargeMeshChunkCount);
+
+        for (int d = 0; d < detailCount; d++) {
+            int i = detailCharges[d];
             Color c = charges[i].value > 0 ? BLUE : RED;
             if (i == selectedCharge) c = WHITE;
             DrawSphere(charges[i].position, 0.25f, c);
             DrawSphereWires(charges[i].position, 0.35f, 8, 8, Fade(c, 0.5f));
         }
 
-        rlDrawRenderBatchActive();      
         BeginBlendMode(BLEND_ADDITIVE);
-        rlBegin(RL_LINES);
-
-        int num_phi = 4 * lineResolution; 
-        int num_theta = 3 * lineResolution; 
-        float startRadius = 0.1f;
-
-        for (int j = 0; j < numCharges; j++) {
-            if (charges[j].value <= 0) continue; 
-
-            for (int t = 1; t < num_theta; t++) {
-                float theta = PI * t / num_theta;
-                float sinTheta = sinf(theta);
-                float cosTheta = cosf(theta);
-
-                for (int p = 0; p < num_phi; p++) {
-                    float phi = 2.0f * PI * p / num_phi;
-                    
-                    float x = charges[j].position.x + startRadius * sinTheta * cosf(phi);
-                    float y = charges[j].position.y + startRadius * sinTheta * sinf(phi);
-                    float z = charges[j].position.z + startRadius * cosTheta;
-
-                    for (int step = 0; step < fieldLineSteps; step++) {
-                        float dx = 0, dy = 0, dz = 0;
-                        float minDistToNeg = 10000.0f;
-                        float minDistToPos = 10000.0f;
-                        bool hitSink = false;
-
-                        for (int k = 0; k < numCharges; k++) {
-                            float rx = x - charges[k].position.x;
-                            float ry = y - charges[k].position.y;
-                            float rz = z - charges[k].position.z;
-                            float r2 = rx*rx + ry*ry + rz*rz;
-
-                            if (r2 < 0.04f) { 
-                                if (charges[k].value < 0) hitSink = true;
-                            }
-                            float r = sqrtf(r2);
-
-                            if (charges[k].value > 0) {
-                                if (r < minDistToPos) minDistToPos = r;
-                            } else {
-                                if (r < minDistToNeg) minDistToNeg = r;
-                            }
-                            
-                            float rInv = 1.0f / r;
-                            float rInv3 = rInv * rInv * rInv;
-                            float s = charges[k].value * rInv3;
-
-                            dx += s * rx;
-                            dy += s * ry;
-                            dz += s * rz;
-                        }
-
-                        if (hitSink) break;
-
-                        float magSq = dx*dx + dy*dy + dz*dz;
-                        if (magSq < 1e-12f) break;
-                        
-                        float invMag = 1.0f / sqrtf(magSq);
-                        dx *= invMag; dy *= invMag; dz *= invMag;
-
-                        Vector3 start = { x, y, z };
-                        x += dx * FIELD_LINE_STEP_SIZE;
-                        y += dy * FIELD_LINE_STEP_SIZE;
-                        z += dz * FIELD_LINE_STEP_SIZE;
-                        
-                        if (x*x + y*y + z*z > 2500.0f) break;
-
-                        float mix = minDistToPos / (minDistToPos + minDistToNeg + 0.001f);
-                        mix = powf(mix, 0.7f); 
-
-                        Color col = CustomColorLerp(BLUE, RED, mix);
-                        float alpha = 1.0f;
-                        if (step > fieldLineSteps - 50) alpha = (fieldLineSteps - step) / 50.0f;
-                        if (minDistToNeg > 20.0f) alpha *= 0.5f;
-
-                        rlCheckRenderBatchLimit(2);
-                        Color finalCol = Fade(col, 0.6f * alpha);
-                        rlColor4ub(finalCol.r, finalCol.g, finalCol.b, finalCol.a);
-                        rlVertex3f(start.x, start.y, start.z);
-                        rlVertex3f(x, y, z);
-                    }
-                }
-            }
-        }
-        rlEnd();
+        DrawFieldLines();
         EndBlendMode();
     EndMode3D();
 
     //Custom Hud
-    for(int i=0; i<numCharges; i++) {
-        Vector2 pos = GetWorldToScreen(charges[i].position, camera);
-        if (pos.x > 0 && pos.x < GetScreenWidth() && pos.y > 0 && pos.y < GetScreenHeight()) {
+    Matrix screenProjection = GetScreenProjection();
+    for (int d = 0; d < detailCount; d++) {
+        int i = detailCharges[d];
+        Vector2 pos;
+        if (ProjectToScreen(screenProjection, charges[i].position, &pos) && 
+            pos.x > 0 && pos.x < GetScreenWidth() && pos.y > 0 && pos.y < GetScreenHeight()) {
             const char* text = TextFormat("%.1f", charges[i].value);
             int textW = MeasureText(text, 20);
             pos.x -= textW/2, pos.y -= 30;
@@ -392,8 +991,8 @@ void UpdateDrawFrame(void)
         }
     }
 
-    DrawRectangle(10, 10, 370, 370, Fade(BLACK, 0.6f));
-    DrawRectangleLines(10, 10, 370, 370, DARKGRAY);
+    DrawRectangle(10, 10, 370, 650, Fade(BLACK, 0.6f));
+    DrawRectangleLines(10, 10, 370, 650, DARKGRAY);
 
     Vector2 posText = {20, 20};
 
@@ -405,9 +1004,40 @@ void UpdateDrawFrame(void)
     DrawTextEx(roboto_regular, "  R-Click: Delete", posText, 20, 2.0f, WHITE); posText.y  += 40;
 
     DrawTextEx(roboto_regular, "Arrow Keys: Density/Length:", posText, 24, 2.0f, ORANGE); posText.y  += 30;
-    DrawTextEx(roboto_regular, TextFormat("  (up/down) Line Density: %d", lineResolution), posText, 20, 2.0f, WHITE); posText.y  += 30;
-    DrawTextEx(roboto_regular, TextFormat("  (left/right) Line Steps: %d", fieldLineSteps), posText, 20, 2.0f, WHITE); posText.y  += 30;
-
+    DrawTextEx(roboto_regular, TextFormat("  (left/right) Lines per Unit Charge: %.1f", linesPerCharge), posText, 20, 2.0f, WHITE); posText.y  += 30;
+    DrawTextEx(roboto_regular, TextFormat("  (up/down) Line Length: %.1f", fieldLineLength), posText, 20, 2.0f, WHITE); posText.y  += 30;
+    DrawTextEx(roboto_regular, TextFormat("  [B] Line Budget: %d", lineBudget), posText, 20, 2.0f, WHITE); posText.y  += 30;
+    DrawTextEx(roboto_regular, TextFormat("  [M] Min Lines per Charge: %d", minLinesPerSource), posText, 20, 2.0f, WHITE); posText.y  += 30;
+    DrawTextEx(roboto_regular, TextFormat("  ([ / ]) Retrace Tolerance: %.2f%%", retraceTolerance * 100.0f), posText, 20, 2.0f, WHITE); posText.y  += 30;
+    const char *overlayNames[OVERLAY_COUNT] = { "Off", "Potential", "|E|" };
+    DrawTextEx(roboto_regular, TextFormat("  [G] Field Overlay: %s", overlayNames[fieldOverlay]), posText, 20, 2.0f, WHITE); posText.y  += 30;
+    DrawTextEx(roboto_regular, TextFormat("  [P] Field Precision: %s", GetFieldPrecisionName(fieldPrecision)), posText, 20, 2.0f, WHITE); posText.y  += 30;
+    DrawTextEx(roboto_regular, TextFormat("  [T] Tree Opening Angle: %.1f%s", treeTheta, 
+               numCharges > FIELD_TREE_MIN_CHARGES && fmmOrder == 0 ? "" : " (off)"), 
+               posText, 20, 2.0f, WHITE); posText.y  += 30;
+    DrawTextEx(roboto_regular, fmmOrder > 0 ? TextFormat("  [O] Multipole Order: %d%s", fmmOrder, numCharges > FIELD_TREE_MIN_CHARGES ? "" : " (off)") 
+                                            : "  [O] Multipole Order: Off", 
+               posText, 20, 2.0f, WHITE); posText.y  += 30;
+    DrawTextEx(roboto_regular, latticeResolution > 0 ? TextFormat("  [L] Field Lattice: %d^3%s", latticeResolution, numCharges >= FIELD_LATTICE_MIN_CHARGES ? "" : " (off)") 
+                                                     : "  [L] Field Lattice: Off", 
+               posText, 20, 2.0f, WHITE); posText.y  += 30;
+    DrawTextEx(roboto_regular, TextFormat("  [N] New Scene: %d charges", numCharges), posText, 20, 2.0f, WHITE); posText.y  += 30;
+
+
+    Vector2 statusPos = { 20, 670 };
+    TraceStats stats = GetTraceStats();
+    const char *cacheStats = TextFormat("Scene cache: %d hits / %d misses (%.1f MB)", 
+                                        stats.cacheHits, stats.cacheMisses, stats.cacheBytes / 1048576.0);
+    DrawTextEx(roboto_regular, cacheStats, statusPos, 18, 2.0f, GRAY); statusPos.y += 25;
+    const char *jobStats = TextFormat("Trace jobs: %d completed / %d cancelled (%s kernel)", 
+                                      stats.completedJobs, stats.cancelledJobs, GetFieldKernelName(GetFieldKernel()));
+    DrawTextEx(roboto_regular, jobStats, statusPos, 18, 2.0f, GRAY); statusPos.y += 25;
+
+    if (tracedVersion != sceneVersion && stats.pendingLines > 0) {
+        const char *progress = TextFormat("Tracing field lines%s... %d%%", 
+                                          stats.preview ? " (preview)" : "", 100 * stats.finishedLines / stats.pendingLines);
+        DrawTextEx(roboto_regular, progress, statusPos, 20, 2.0f, ORANGE);
+    }
 
     if (isTyping) {
         DrawTextEx(roboto_regular, "ENTER VALUE:", posText, 28, 2.0f, GREEN); posText.x += 190;
@@ -440,14 +1070,24 @@ int main(void)
     cameraPitch = asinf(forward.y);
     cameraYaw = atan2f(forward.x, forward.z);
 
-    charges[0] = (Charge){{-8, 0, 8}, 10.0f};
-    charges[1] = (Charge){{8, 0, 8}, -10.0f};
-    charges[2] = (Charge){{8, 0, -8}, 10.0f};
-    charges[3] = (Charge){{-8, 0, -8}, -10.0f};
-    numCharges = 4;
+    LoadChargeScene(4);
+
+    // Ground-plane overlay samples, two per grid cell
+    groundGrid = LoadFieldGrid(201, 1, 201, (Vector3){ -50.0f, 0.0f, -50.0f }, 0.5f);
+    groundGridNext = LoadFieldGrid(201, 1, 201, (Vector3){ -50.0f, 0.0f, -50.0f }, 0.5f);
+    Image overlayImage = GenImageColor(groundGrid.nx, groundGrid.nz, BLANK);
+    groundGridTexture = LoadTextureFromImage(overlayImage);
+    UnloadImage(overlayImage);
+    SetTextureFilter(groundGridTexture, TEXTURE_FILTER_BILINEAR);
+    groundGridPixels = malloc(groundGrid.nx * groundGrid.nz * sizeof(Color));
 
     DisableCursor();
 
+    InitFieldKernels();
+#if defined(TRACE_THREADED)
+    StartTraceWorker();
+#endif
+
 #if defined(PLATFORM_WEB)
     // 1: Get the current size of the browser window (element size)
     double w = initialWidth;
@@ -474,6 +1114,21 @@ int main(void)
     }
 #endif
 
+#if defined(TRACE_THREADED)
+    StopTraceWorker();
+#else
+    UnloadTraceState(&traceState);
+    UnloadLineSet(&frontLines);
+    ClearSceneCache();
+#endif
+    UnloadLineMesh();
+    UnloadChargeMesh();
+    UnloadTexture(groundGridTexture);
+    UnloadFieldGrid(&groundGrid);
+    UnloadFieldGrid(&groundGridNext);
+    UnloadFieldTree(&groundGridTree);
+    free(groundGridPixels);
+
     CloseWindow();
     return 0;
 }